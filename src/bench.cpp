@@ -0,0 +1,772 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "util.hpp"
+#include "confparse.hpp"
+#include "cache.hpp"
+#include "reload.hpp"
+#include "snapshot.hpp"
+#include "writer.hpp"
+#include "schema.hpp"
+#include "overlay.hpp"
+#include "interpolate.hpp"
+
+// every allocation made by the process is counted so that phases can report
+// allocations per kv
+static std::atomic<std::size_t> g_allocs = 0;
+
+#if defined __GNUC__ && !defined __clang__
+// gcc cannot see that these replace the global allocation functions
+#   pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n == 0 ? 1 : n))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+
+// splitmix64; unlike the <random> distributions its output is the same on
+// every standard library, so a given seed always generates the same file
+struct rng {
+    std::uint64_t state;
+
+    std::uint64_t next() noexcept {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    std::uint64_t below(std::uint64_t n) noexcept { return next() % n; }
+
+    // true with probability percent / 100
+    bool chance(unsigned percent) noexcept { return below(100) < percent; }
+};
+
+struct gen_options {
+    std::size_t sections = 2000;
+    std::size_t keys = 25;          // per section
+    std::size_t depth = 1;          // components in a dotted section name
+    // relative weights of BOOL, INT, UINT, FLOAT, STRING values
+    std::array<unsigned, 5> mix = { 1, 1, 2, 1, 3 };
+    unsigned comments = 10;         // % of lines that are or end in comments
+    unsigned escapes = 10;          // % of strings with escaped quotes
+    std::size_t line_length = 40;   // approximate length of string kv lines
+    std::uint64_t seed = 1;
+};
+
+void append_string_value(std::string& out, rng& r, const gen_options& o,
+                         std::size_t used) {
+    static constexpr std::string_view alphabet =
+        "abcdefghijklmnopqrstuvwxyz0123456789 -_/.:";
+
+    const std::size_t len =
+        o.line_length > used + 2 ? o.line_length - used - 2 : 1;
+    out += '"';
+    for (std::size_t i = 0; i < len; ++i) {
+        if (o.escapes != 0 && r.chance(o.escapes) && i + 1 < len) {
+            out += "\\\"";
+            ++i;
+            continue;
+        }
+        out += alphabet[r.below(alphabet.size())];
+    }
+    // a trailing space or backslash would change the meaning of the line
+    if (out.back() == ' ' || out.back() == '\\')
+        out.back() = 'x';
+    out += '"';
+}
+
+void append_value(std::string& out, rng& r, const gen_options& o,
+                  std::size_t used) {
+    unsigned total = 0;
+    for (const auto w : o.mix)
+        total += w;
+
+    auto pick = static_cast<unsigned>(r.below(total == 0 ? 1 : total));
+    std::size_t type = 0;
+    while (type + 1 < o.mix.size() && pick >= o.mix[type])
+        pick -= o.mix[type++];
+
+    switch (type) {
+    case 0:
+        out += r.chance(50) ? "true" : "false";
+        break;
+    case 1:
+        out += util::format("-{}", r.below(1'000'000'000));
+        break;
+    case 2:
+        if (r.chance(20))
+            out += util::format("0x{:x}", r.next() >> 16);
+        else
+            out += util::format("{}", r.below(100'000));
+        break;
+    case 3:
+        out += util::format("{}.{}", r.below(10'000), r.below(1000));
+        break;
+    default:
+        append_string_value(out, r, o, used);
+        break;
+    }
+}
+
+NO_DISCARD std::string generate(const gen_options& o) {
+    rng r{ o.seed };
+    std::string out;
+    out.reserve(o.sections * o.keys * (o.line_length + 8));
+
+    for (std::size_t s = 0; s <= o.sections; ++s) {
+        // section 0 holds the global kvs
+        if (s != 0) {
+            out += "\n[";
+            for (std::size_t d = 0; d < o.depth; ++d) {
+                if (d != 0)
+                    out += '.';
+                out += util::format("sec{}", d == 0 ? s : r.below(8));
+            }
+            out += "]\n";
+        }
+
+        for (std::size_t k = 0; k < o.keys; ++k) {
+            if (o.comments != 0 && r.chance(o.comments)) {
+                out += r.chance(50) ? "# " : "; ";
+                out += "generated comment line\n";
+            }
+
+            const std::size_t line_begin = out.size();
+            out += util::format("key_{} = ", k);
+            append_value(out, r, o, out.size() - line_begin);
+            if (o.comments != 0 && r.chance(o.comments))
+                out += " # trailing";
+            out += '\n';
+        }
+    }
+    return out;
+}
+
+// lines the generator does not write, for the checks run before timing:
+// quotes inside bare words, a quote left open at the end of its line,
+// escaped quotes, arrays, hex floats, and numbers the writer has to take
+// care over
+constexpr std::string_view EDGE_CASES =
+    "zero = -0\n"
+    "[edge.quotes]\n"
+    "bare = abc\"def # not part of the value\n"
+    "inner = a\"b\"c ; nor this\n"
+    "open = \"no closing quote # so no comment either\n"
+    "after_open = 1\n"
+    "escaped = \"say \\\"hi\\\" ; inside\" # outside\n"
+    "ends_escaped = \"a\\\\\\\"\"\n"
+    "[edge.numbers]\n"
+    "hex_float = 0x1.8p3\n"
+    "neg_hex_float = -0x1.fp-2\n"
+    "whole = 2.0\n"
+    "neg_zero = -0.0\n"
+    "big = 1e300\n"
+    "tiny = 5e-324\n"
+    "neg_zero_int = -0\n"
+    "[edge.arrays]\n"
+    "uints = [1, 2, 0x10]\n"
+    "ints = [0, -1, 7]\n"
+    "floats = [0x1p4, -0.5, 3.0]\n"
+    "mixed = [1, \"x, y\", \"q\\\"r\", bare, -0, 2.5]\n"
+    "empty = []\n"
+    "not valid\n"
+    "\n";
+
+// true if a and b have the same sections, with the same kvs in the same
+// order holding equal values
+NO_DISCARD bool same_document(const document& a, const document& b) {
+    if (a.sections.size() != b.sections.size() || a.kvs.size() != b.kvs.size())
+        return false;
+    for (section_id id = 0; id < a.sections.size(); ++id) {
+        if (a.sections[id].path != b.sections[id].path)
+            return false;
+        const auto x = a.kvs_of(id);
+        const auto y = b.kvs_of(id);
+        if (x.size() != y.size())
+            return false;
+        for (std::size_t i = 0; i < x.size(); ++i) {
+            if (x[i].key != y[i].key ||
+                !kv::values_equal(a.value_of(x[i]), b.value_of(y[i])))
+                return false;
+        }
+    }
+    return true;
+}
+
+// a parse split between threads must find the same document, and the same
+// invalid lines, as a sequential one. min_chunk is kept small so that
+// chunk boundaries fall throughout buf.
+void check_parallel(std::string_view buf, unsigned threads) {
+    parse_options po;
+    po.min_chunk = 1;
+    diagnostics one_diags;
+    po.diagnostics = &one_diags;
+    document one;
+    parse_buffer(buf, one, po);
+
+    po.threads = threads;
+    diagnostics n_diags;
+    po.diagnostics = &n_diags;
+    document n;
+    parse_buffer(buf, n, po);
+
+    bool same = same_document(one, n) && one_diags.count() == n_diags.count();
+    const auto x = one_diags.records();
+    const auto y = n_diags.records();
+    for (std::size_t i = 0; same && i < x.size(); ++i) {
+        same = x[i].offset == y[i].offset && x[i].line == y[i].line &&
+               x[i].column == y[i].column && x[i].code == y[i].code;
+    }
+    if (!same) {
+        throw std::runtime_error(util::format(
+            "a parse on {} threads differs from a sequential one.", threads));
+    }
+}
+
+// writing a document out in canonical form and parsing that must give
+// back the same document
+void check_round_trip(std::string_view buf) {
+    document doc;
+    parse_buffer(buf, doc);
+    fmt::memory_buffer out;
+    write_document(doc, out);
+    document again;
+    parse_buffer(std::string_view(out.data(), out.size()), again);
+    if (!same_document(doc, again))
+        throw std::runtime_error("canonical form does not read back the same.");
+}
+
+struct phase_result {
+    std::string_view name;
+    double seconds = 0;
+    std::size_t allocs = 0;
+};
+
+// runs f iterations times and keeps the fastest run, counting the
+// allocations made during that run
+template<typename F>
+NO_DISCARD phase_result
+run_phase(std::string_view name, std::size_t iterations, F&& f) {
+    phase_result best{ name, 1e300, 0 };
+    for (std::size_t i = 0; i < iterations; ++i) {
+        const std::size_t allocs_before = g_allocs.load();
+        const auto t0 = std::chrono::steady_clock::now();
+        f();
+        const auto t1 = std::chrono::steady_clock::now();
+        const double secs = std::chrono::duration<double>(t1 - t0).count();
+        if (secs < best.seconds) {
+            best.seconds = secs;
+            best.allocs = g_allocs.load() - allocs_before;
+        }
+    }
+    return best;
+}
+
+// defeats dead-code elimination of the phase bodies
+volatile std::size_t g_sink = 0;
+
+constexpr std::chrono::milliseconds CONTENTION_TIME{ 250 };
+
+// runs readers threads that each look keys up through a function made by
+// make_reader(), while one more thread calls publish() back to back.
+// returns lookups per second across all readers.
+template<typename MakeReader, typename Publish>
+NO_DISCARD double run_contended(unsigned readers,
+                                std::chrono::milliseconds duration,
+                                MakeReader&& make_reader,
+                                Publish&& publish) {
+    std::atomic<bool> stop = false;
+    std::atomic<std::size_t> total = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    {
+        std::vector<std::jthread> pool;
+        pool.reserve(readers + 1);
+        for (unsigned t = 0; t < readers; ++t) {
+            pool.emplace_back([&, t] {
+                auto lookup = make_reader();
+                std::size_t n = 0;
+                std::size_t hits = 0;
+                for (std::size_t i = t * 7919; 
+                     !stop.load(std::memory_order_relaxed); 
+                     ++i, ++n)
+                    hits += lookup(i);
+                total += n;
+                g_sink = hits;
+            });
+        }
+        pool.emplace_back([&] {
+            while (!stop.load(std::memory_order_relaxed))
+                publish();
+        });
+        std::this_thread::sleep_for(duration);
+        stop = true;
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    return static_cast<double>(total) / 
+           std::chrono::duration<double>(t1 - t0).count();
+}
+
+NO_DISCARD bool parse_args(int argc, char** argv,
+                           gen_options& o,
+                           std::size_t& iterations,
+                           unsigned& threads,
+                           std::string& path) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const std::string_view opt = argv[i];
+        const std::string_view arg = argv[i + 1];
+        if (opt == "--out") {
+            path = arg;
+            continue;
+        }
+        if (opt == "--mix") {
+            // bool:int:uint:float:string weights, e.g. 1:1:2:1:3
+            std::size_t pos = 0;
+            for (auto& w : o.mix) {
+                if (pos > arg.size())
+                    return false;
+                const auto [p, ec] =
+                    std::from_chars(arg.data() + pos,
+                                    arg.data() + arg.size(), w);
+                if (ec != std::errc())
+                    return false;
+                pos = static_cast<std::size_t>(p - arg.data()) + 1;
+            }
+            continue;
+        }
+
+        std::uint64_t n = 0;
+        const auto [p, ec] =
+            std::from_chars(arg.data(), arg.data() + arg.size(), n);
+        if (ec != std::errc() || p != arg.data() + arg.size())
+            return false;
+
+        if (opt == "--sections")
+            o.sections = n;
+        else if (opt == "--keys")
+            o.keys = n;
+        else if (opt == "--depth")
+            o.depth = std::max<std::size_t>(n, 1);
+        else if (opt == "--comments")
+            o.comments = static_cast<unsigned>(n);
+        else if (opt == "--escapes")
+            o.escapes = static_cast<unsigned>(n);
+        else if (opt == "--line-length")
+            o.line_length = n;
+        else if (opt == "--seed")
+            o.seed = n;
+        else if (opt == "--iterations")
+            iterations = std::max<std::size_t>(n, 1);
+        else if (opt == "--threads")
+            threads = std::max(static_cast<unsigned>(n), 1U);
+        else
+            return false;
+    }
+    return argc % 2 == 1;
+}
+
+} // namespace
+
+// a few kvs spread over the generated file, bound to a struct; the rest
+// are unknown keys for the binder to skip
+struct bench_config {
+    double first = 0;
+    double mid = 0;
+    double last = 0;
+    std::string_view global = {};
+};
+
+template<> struct schema<bench_config> {
+    static constexpr std::tuple fields = {
+        bind_field("sec1.key_1", &bench_config::first),
+        bind_field("sec1000.key_2", &bench_config::mid),
+        bind_field("sec2000.key_3", &bench_config::last),
+        bind_field("key_0", &bench_config::global)
+    };
+};
+
+int main(int argc, char** argv) {
+    gen_options o;
+    std::size_t iterations = 5;
+    unsigned threads = util::hardware_threads();
+    // the generated config, and its compiled form beside it, stay out of
+    // the working tree unless --out says otherwise
+    std::string path =
+        (std::filesystem::temp_directory_path() / "bench.conf").string();
+    if (!parse_args(argc, argv, o, iterations, threads, path)) {
+        util::error("usage: bench [--sections N] [--keys N] [--depth N] "
+                    "[--mix b:i:u:f:s] [--comments %] [--escapes %] "
+                    "[--line-length N] [--seed N] [--iterations N] "
+                    "[--threads N] [--out path]");
+        return -1;
+    }
+
+    try {
+        {
+            const std::string text = generate(o);
+            std::ofstream f(path, std::ios::binary);
+            if (!f.write(text.data(), static_cast<std::streamsize>(text.size())))
+                throw std::runtime_error("failed to write generated config.");
+        }
+
+        const file_buffer file = load_file(path);
+        const std::string_view buf = file.view();
+        const std::size_t lines =
+            static_cast<std::size_t>(std::count(buf.begin(), buf.end(), '\n'));
+        const std::size_t kvs = (o.sections + 1) * o.keys;
+
+        std::vector<phase_result> results;
+
+        results.push_back(run_phase("load", iterations, [&] {
+            // touch every page so mapping cost is not deferred to a later
+            // phase
+            const file_buffer f = load_file(path);
+            std::size_t sum = 0;
+            for (std::size_t i = 0; i < f.size(); i += 4096)
+                sum += static_cast<unsigned char>(f.data()[i]);
+            g_sink = sum;
+        }));
+
+        // stage 1 alone, over the same sliding window the parser uses
+        auto scan = [&](bool force_scalar) {
+            structural_masks m;
+            std::size_t sum = 0;
+            for (std::size_t pos = 0; pos < buf.size(); ) {
+                const std::size_t end =
+                    std::min(buf.size(), pos + line_scanner::WINDOW);
+                scan_structurals(buf, pos, end, m, force_scalar);
+                sum += m.structural.back();
+                pos = end;
+            }
+            g_sink = sum;
+        };
+        results.push_back(run_phase("scan", iterations, [&] {
+            scan(false);
+        }));
+        results.push_back(run_phase("scan-sc", iterations, [&] {
+            scan(true);
+        }));
+
+        // the remaining phases run the pipeline up to and including the
+        // named stage over the already loaded buffer. comments are cut off
+        // as lines are split, so "strip" is stage 1 plus stage 2.
+        results.push_back(run_phase("strip", iterations, [&] {
+            std::size_t sum = 0;
+            line_scanner sc(buf);
+            for (line_tokens t; sc.next(t); )
+                sum += t.end - t.begin;
+            g_sink = sum;
+        }));
+
+        results.push_back(run_phase("tokenize", iterations, [&] {
+            std::size_t sum = 0;
+            line_scanner sc(buf);
+            for (line_tokens t; sc.next(t); ) {
+                std::string_view k, v;
+                if (!ERROR(tokenize_kv(sc, t, k, v)))
+                    sum += k.size() + v.size();
+            }
+            g_sink = sum;
+        }));
+
+        results.push_back(run_phase("classify", iterations, [&] {
+            std::size_t sum = 0;
+            line_scanner sc(buf);
+            for (line_tokens t; sc.next(t); ) {
+                std::string_view k, v;
+                if (!ERROR(tokenize_kv(sc, t, k, v)))
+                    sum += static_cast<std::size_t>(classify_value(v).type);
+            }
+            g_sink = sum;
+        }));
+
+        results.push_back(run_phase("sax", iterations, [&] {
+            struct counter {
+                std::size_t kvs = 0;
+                void on_section(std::string_view) { }
+                void on_kv(std::string_view, const kv::value_ref&) { ++kvs; }
+                void on_error(const diagnostic&) { }
+            } h;
+            parse_events(buf, h);
+            g_sink = h.kvs;
+        }));
+
+        results.push_back(run_phase("schema", iterations, [&] {
+            bench_config c;
+            const bind_result r = parse_into(buf, c);
+            g_sink = r.bound + r.unknown;
+        }));
+
+        results.push_back(run_phase("build", iterations, [&] {
+            document doc;
+            parse_buffer(buf, doc);
+            g_sink = doc.kvs.size();
+        }));
+
+        // tokenizing only, then reading every 16th value as a typical 
+        // program reads a few of its settings
+        results.push_back(run_phase("build-lazy", iterations, [&] {
+            parse_options po;
+            po.lazy = true;
+            document doc;
+            parse_buffer(buf, doc, po);
+            const kv::storage st = doc.storage();
+            std::size_t sum = 0;
+            for (std::size_t i = 0; i < doc.kvs.size(); i += 16)
+                sum += static_cast<std::size_t>(doc.kvs[i].val.kind(st));
+            g_sink = sum;
+        }));
+
+        // parallel build scaling, doubling the thread count up to --threads
+        std::vector<unsigned> counts;
+        for (unsigned n = 1; n < threads; n *= 2)
+            counts.push_back(n);
+        counts.push_back(threads);
+
+        // parallel parses are only timed once they are known to agree with
+        // sequential ones, on the generated file and on many copies of the
+        // edge cases
+        std::string edges;
+        for (int i = 0; i < 64; ++i)
+            edges += EDGE_CASES;
+        for (const auto n : counts) {
+            if (n > 1) {
+                check_parallel(buf, n);
+                check_parallel(edges, n);
+            }
+        }
+
+        std::vector<std::string> names;
+        names.reserve(counts.size()); // results keep views of these
+        for (const auto n : counts) {
+            parse_options po;
+            po.threads = n;
+            po.min_chunk = 1 << 16;
+            names.push_back(util::format("build-{}t", n));
+            results.push_back(run_phase(names.back(), iterations, [&] {
+                document doc;
+                parse_buffer(buf, doc, po);
+                g_sink = doc.kvs.size();
+            }));
+        }
+
+        // reloading the unchanged file, which reuses every section
+        reloader live(path);
+        results.push_back(run_phase("reload", iterations, [&] {
+            live.reload();
+            g_sink = live.current().kvs.size();
+        }));
+
+        // loading the compiled form instead of parsing; rates are relative
+        // to the text it was compiled from
+        const std::string cache_path = path + ".cache";
+        write_cache(parse_file(path), path, cache_path);
+        results.push_back(run_phase("cached", iterations, [&] {
+            const auto doc = load_cache(path, cache_path);
+            if (!doc)
+                throw std::runtime_error("cache was not usable.");
+            g_sink = doc->kvs.size();
+        }));
+
+        // the document under an overlay that resets a key in every eighth
+        // section, both parsed with the same symbols: looking up every key
+        // through the layers, and merging them into one document
+        {
+            parse_options po;
+            po.symbols = std::make_shared<symbol_table>();
+            auto base = std::make_shared<document>();
+            parse_buffer(buf, *base, po);
+
+            std::vector<std::string> paths;
+            std::string top;
+            for (section_id id = 0; id < base->sections.size(); ++id) {
+                const section& s = base->sections[id];
+                for (const auto& p : base->kvs_of(id)) {
+                    paths.push_back(id == 0 ? 
+                        std::string(p.key) : 
+                        util::format("{}.{}", s.path, p.key));
+                }
+                if (id % 8 == 1 && s.kv_count != 0) {
+                    top += util::format("[{}]\n{} = 0\n", 
+                                        s.path, base->kvs_of(id).front().key);
+                }
+            }
+            auto overlay = std::make_shared<document>();
+            parse_buffer(top, *overlay, po);
+
+            const layered_document layered = 
+                layered_document(base).with(overlay);
+            results.push_back(run_phase("layered", iterations, [&] {
+                std::size_t hits = 0;
+                for (const auto& p : paths)
+                    hits += layered.find(p) ? 1 : 0;
+                g_sink = hits;
+            }));
+            results.push_back(run_phase("flatten", iterations, [&] {
+                g_sink = layered.flatten().kvs.size();
+            }));
+        }
+
+        // the document with a section of strings that each refer to two
+        // kvs of another section: expanding every one of them with a new
+        // interpolator, and reading them again once they are remembered
+        {
+            document plain;
+            parse_buffer(buf, plain);
+            std::string text(buf);
+            text += "\n[refs]\n";
+            std::vector<std::string> paths;
+            for (section_id id = 1; id < plain.sections.size(); ++id) {
+                const auto ps = plain.kvs_of(id);
+                if (ps.size() < 2)
+                    continue;
+                const std::string_view sp = plain.sections[id].path;
+                text += util::format("r{} = \"${{{}.{}}}:${{{}.{}}}\"\n", 
+                                     paths.size(), sp, ps[0].key, sp, ps[1].key);
+                paths.push_back(util::format("refs.r{}", paths.size()));
+            }
+            document doc;
+            parse_buffer(text, doc);
+
+            auto expand_all = [&](interpolator& interp) {
+                std::size_t n = 0;
+                for (const auto& p : paths) {
+                    const auto r = interp.get(doc, p);
+                    if (!r)
+                        throw std::runtime_error("interpolation failed.");
+                    n += r->size();
+                }
+                g_sink = n;
+            };
+            results.push_back(run_phase("interp", iterations, [&] {
+                interpolator interp;
+                expand_all(interp);
+            }));
+            interpolator warm;
+            expand_all(warm);
+            results.push_back(run_phase("interp-hit", iterations, [&] {
+                expand_all(warm);
+            }));
+        }
+
+        // writing the parsed document back out, in canonical form and
+        // copying the original lines
+        {
+            check_round_trip(buf);
+            check_round_trip(EDGE_CASES);
+            const document doc = parse_file(path);
+            for (const bool keep : { false, true }) {
+                write_options wo;
+                wo.keep_original = keep;
+                results.push_back(run_phase(keep ? "write-keep" : "write", 
+                                            iterations, [&] {
+                    fmt::memory_buffer out;
+                    write_document(doc, out, wo);
+                    g_sink = out.size();
+                }));
+            }
+        }
+
+        util::log("{} bytes, {} lines, {} kvs, best of {} runs",
+                  buf.size(), lines, kvs, iterations);
+        util::log("{:<10} {:>10} {:>10} {:>12} {:>11}",
+                  "phase", "ms", "MB/s", "Mlines/s", "allocs/kv");
+        for (const auto& r : results) {
+            util::log("{:<10} {:>10.3f} {:>10.1f} {:>12.2f} {:>11.3f}",
+                      r.name,
+                      r.seconds * 1e3,
+                      static_cast<double>(buf.size()) / r.seconds / 1e6,
+                      static_cast<double>(lines) / r.seconds / 1e6,
+                      kvs == 0 ? 0.0 :
+                          static_cast<double>(r.allocs) /
+                          static_cast<double>(kvs));
+        }
+
+        // readers looking keys up while the document is republished as fast
+        // as it can be parsed: snapshots from a document_store against a
+        // shared_ptr swapped under a mutex
+        std::vector<std::string> keys;
+        {
+            const document doc = parse_file(path);
+            for (section_id id = 0; 
+                 id < doc.sections.size() && keys.size() < (1 << 16); 
+                 ++id) {
+                for (const auto& p : doc.kvs_of(id)) {
+                    keys.push_back(id == 0 ? 
+                        std::string(p.key) : 
+                        util::format("{}.{}", doc.sections[id].path, p.key));
+                }
+            }
+        }
+        if (keys.empty())
+            keys.emplace_back("");
+
+        auto parse = [&] {
+            document doc;
+            parse_buffer(buf, doc);
+            return doc;
+        };
+
+        util::log("");
+        util::log("{:<10} {:>14} {:>14}", "readers", "snapshot M/s", "mutex M/s");
+        for (const auto n : counts) {
+            document_store store(parse());
+            const double rcu = run_contended(n, CONTENTION_TIME, [&] {
+                return [r = store.register_reader(), &keys](std::size_t i) mutable {
+                    const auto s = r.read();
+                    return s->find(keys[i % keys.size()]) != nullptr;
+                };
+            }, [&] {
+                store.publish(parse());
+            });
+
+            std::mutex m;
+            std::shared_ptr<const document> current = 
+                std::make_shared<const document>(parse());
+            const double locked = run_contended(n, CONTENTION_TIME, [&] {
+                return [&](std::size_t i) {
+                    std::shared_ptr<const document> d;
+                    {
+                        const std::lock_guard lock(m);
+                        d = current;
+                    }
+                    return d->find(keys[i % keys.size()]) != nullptr;
+                };
+            }, [&] {
+                auto next = std::make_shared<const document>(parse());
+                const std::lock_guard lock(m);
+                current.swap(next);
+            });
+
+            util::log("{:<10} {:>14.2f} {:>14.2f}", n, rcu / 1e6, locked / 1e6);
+        }
+    } catch (const std::exception& e) {
+        util::error("bench: uncaught exception: {}", e.what());
+        return -5;
+    }
+}
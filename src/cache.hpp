@@ -0,0 +1,630 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <array>
+#include <expected>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "util.hpp"
+#include "loader.hpp"
+#include "hash_index.hpp"
+#include "symbols.hpp"
+#include "confparse.hpp"
+
+// a compiled document: the section table, the distinct keys, kvs, array
+// elements, packed arrays and the indexes as fixed-size records, followed
+// by a pool holding every name, key and out-of-line string they refer to.
+// records refer to the pool by offset, so the file can be mapped anywhere
+// and loaded without parsing; each table starts at a multiple of 
+// cache::ALIGNMENT, so that the arrays and indexes are read in place. 
+// symbol ids are only meaningful within a process, so kvs refer to keys by
+// their position in the file's own list, which is in symbol order and 
+// saved with each key's hash, and the loader interns the list in one go
+// once the whole file has been checked. the kv index is saved only if every key's 
+// position is its symbol, and used only if that is still so once the 
+// loader has interned them, as it is whenever documents are compiled and
+// loaded with tables of their own.
+//
+//     header | sections | keys | kvs | elements | ints | uints | floats 
+//     | section slots | kv slots | key slots | pool
+//
+// the file is written in the byte order and layout of the machine that
+// wrote it; readers on a different machine see a mismatch and reparse.
+inline static constexpr std::array<char, 8> CACHE_MAGIC = {
+    'C', 'O', 'N', 'F', 'P', 'C', 'H', '\0'
+};
+// bump whenever the layout of the file or of kv::value changes
+inline static constexpr std::uint32_t CACHE_VERSION = 5;
+inline static constexpr std::uint32_t CACHE_BYTE_ORDER = 0x01020304U;
+
+enum class CACHE_ERROR : int8_t {
+    MISSING = -1,  // there is no cache file
+    STALE   = -2,  // the source has changed since the cache was written
+    CORRUPT = -3,  // the cache is truncated, garbled or from another version
+};
+
+namespace cache {
+
+// what a cache was compiled from. the source is considered unchanged if
+// its size and modification time match, or failing that, its size and the
+// hash of its contents.
+struct source_key {
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+    std::uint64_t hash = 0;
+};
+
+struct header {
+    std::array<char, 8> magic;
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    // kv::value differs between builds that store floats differently
+    std::uint32_t value_size;
+    std::uint32_t float_size;
+    source_key source;
+    std::uint64_t section_count;
+    std::uint64_t kv_count;
+    std::uint64_t element_count;
+    std::uint64_t int_count;
+    std::uint64_t uint_count;
+    std::uint64_t float_count;
+    std::uint64_t key_count;
+    std::uint64_t section_slots;
+    std::uint64_t kv_slots;
+    std::uint64_t key_slots;
+    std::uint64_t pool_size;
+    std::uint64_t checksum;  // of the bytes above
+};
+
+// the pool offset and size of a section's path; its name is the last
+// name_size bytes of the path
+struct section_record {
+    std::uint32_t path_offset;
+    std::uint32_t path_size;
+    std::uint32_t name_size;
+    section_id parent;
+    section_id first_child;
+    section_id next_sibling;
+    std::uint32_t first_kv;
+    std::uint32_t kv_count;
+};
+
+// the pool offset and size of a distinct key, and its util::hash_bytes()
+struct key_record {
+    std::uint32_t offset;
+    std::uint32_t size;
+    std::uint64_t hash;
+};
+
+// key is an index into the file's keys; val's out-of-line strings are 
+// offsets into the pool
+struct kv_record {
+    std::uint32_t key;
+    std::uint32_t reserved;
+    kv::value val;
+};
+
+static_assert(std::has_unique_object_representations_v<header>);
+static_assert(sizeof(section_record) % 8 == 0 && sizeof(key_record) % 8 == 0 &&
+              sizeof(kv_record) % 8 == 0);
+static_assert(sizeof(hash_index::slot) == 8);
+
+inline static constexpr std::size_t ALIGNMENT = 16;
+static_assert(alignof(kv::value) <= ALIGNMENT && 
+              alignof(kv_record) <= ALIGNMENT &&
+              alignof(std::intmax_t) <= ALIGNMENT &&
+              alignof(kv::float_type) <= ALIGNMENT);
+
+NO_DISCARD constexpr std::size_t align_up(std::size_t n) noexcept {
+    return (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+// where each table of a file begins, and where the file ends
+struct layout {
+    std::size_t sections;
+    std::size_t keys;
+    std::size_t kvs;
+    std::size_t elements;
+    std::size_t ints;
+    std::size_t uints;
+    std::size_t floats;
+    std::size_t section_slots;
+    std::size_t kv_slots;
+    std::size_t key_slots;
+    std::size_t pool;
+    std::size_t size;
+};
+
+// the counts must have been checked to be below NO_INDEX
+NO_DISCARD inline layout layout_of(const header& h) noexcept {
+    layout l;
+    l.sections = align_up(sizeof(header));
+    l.keys = align_up(l.sections + h.section_count * sizeof(section_record));
+    l.kvs = align_up(l.keys + h.key_count * sizeof(key_record));
+    l.elements = align_up(l.kvs + h.kv_count * sizeof(kv_record));
+    l.ints = align_up(l.elements + h.element_count * sizeof(kv::value));
+    l.uints = align_up(l.ints + h.int_count * sizeof(std::intmax_t));
+    l.floats = align_up(l.uints + h.uint_count * sizeof(std::size_t));
+    l.section_slots = 
+        align_up(l.floats + h.float_count * sizeof(kv::float_type));
+    l.kv_slots = align_up(
+        l.section_slots + h.section_slots * sizeof(hash_index::slot));
+    l.key_slots = 
+        align_up(l.kv_slots + h.kv_slots * sizeof(hash_index::slot));
+    l.pool = align_up(l.key_slots + h.key_slots * sizeof(hash_index::slot));
+    l.size = l.pool + h.pool_size;
+    return l;
+}
+
+// the n records of type T at offset i of a buffer that holds them, read in
+// place
+template<typename T>
+NO_DISCARD std::span<const T> 
+table_at(std::string_view buf, std::size_t i, std::size_t n) noexcept {
+    return { reinterpret_cast<const T*>(buf.data() + i), n };
+}
+
+NO_DISCARD inline std::uint64_t header_checksum(const header& h) noexcept {
+    return util::hash_bytes(
+        { reinterpret_cast<const char*>(&h), offsetof(header, checksum) });
+}
+
+NO_DISCARD inline std::int64_t
+modification_time(std::string_view path, std::error_code& ec) noexcept {
+    const auto t = std::filesystem::last_write_time(path, ec);
+    return ec ? 0 : static_cast<std::int64_t>(t.time_since_epoch().count());
+}
+
+// copies the record at offset i of buf into out, if it lies within buf
+template<typename T>
+NO_DISCARD bool read_record(std::string_view buf, std::size_t i, T& out) noexcept {
+    if (i > buf.size() || buf.size() - i < sizeof(T))
+        return false;
+    std::memcpy(&out, buf.data() + i, sizeof(T));
+    return true;
+}
+
+// appends strings to a pool whose final size is known up front, so that the
+// views handed out stay valid while it grows
+class pool_builder {
+public:
+    explicit pool_builder(std::size_t capacity) { pool_.reserve(capacity); }
+
+    NO_DISCARD std::string_view append(std::string_view s) {
+        const std::size_t at = pool_.size();
+        pool_.append(s);
+        return { pool_.data() + at, s.size() };
+    }
+
+    NO_DISCARD std::uint32_t offset_of(std::string_view s) const noexcept {
+        return static_cast<std::uint32_t>(s.data() - pool_.data());
+    }
+
+    // the whole reserved range, which every view appended lies within
+    NO_DISCARD std::string_view text() const noexcept {
+        return { pool_.data(), pool_.capacity() };
+    }
+
+    NO_DISCARD const std::string& str() const noexcept { return pool_; }
+
+private:
+    std::string pool_;
+};
+
+} // namespace cache
+
+// compiles doc, parsed from the file at source, into a cache file at path.
+// doc must have been parsed from source, not itself loaded from a cache.
+// the source is hashed again first so that a file changed since it was
+// parsed is not recorded as the document's source. the cache is written to
+// a temporary file and renamed into place, so readers never see half of it.
+inline void
+write_cache(const document& doc, std::string_view source, std::string_view path) {
+    std::error_code ec;
+    cache::source_key key;
+    key.mtime = cache::modification_time(source, ec);
+    if (ec)
+        throw std::runtime_error("failed to stat source file.");
+    key.size = doc.text.size();
+    key.hash = util::hash_bytes(doc.text);
+    {
+        const file_buffer now = load_file(source);
+        if (now.size() != key.size || util::hash_bytes(now.view()) != key.hash)
+            throw std::runtime_error("source file changed while compiling.");
+    }
+
+    const kv::storage st = doc.storage();
+    auto out_of_line = [&](const kv::value& v) -> std::string_view {
+        const auto s = v.as_string(st);
+        return s && s->size() > kv::value::INLINE_CAPACITY ? *s :
+                                                             std::string_view{};
+    };
+
+    // each distinct key is written once, numbered in symbol order
+    std::vector<std::uint32_t> key_of(doc.symbols->size(), NO_SYMBOL);
+    for (const auto& p : doc.kvs)
+        key_of[p.sym] = 0;
+    std::vector<std::string_view> keys;
+    for (symbol_id sym = 0; sym < key_of.size(); ++sym) {
+        if (key_of[sym] == NO_SYMBOL)
+            continue;
+        key_of[sym] = static_cast<std::uint32_t>(keys.size());
+        keys.push_back(doc.symbols->name(sym));
+    }
+    const bool same_ids = keys.size() == key_of.size();
+
+    std::size_t pool_size = 0;
+    for (const auto& s : doc.sections)
+        pool_size += s.path.size();
+    for (const auto& k : keys)
+        pool_size += k.size();
+    for (const auto& p : doc.kvs)
+        pool_size += out_of_line(p.val).size();
+    for (const auto& v : st.elements)
+        pool_size += out_of_line(v).size();
+    if (pool_size >= NO_INDEX)
+        throw std::length_error("document too large to compile.");
+
+    cache::pool_builder pool(pool_size);
+    // strings move to the pool; everything else is copied as it is, with
+    // lazy values converted since their raw tokens are not kept
+    auto relocate = [&](const kv::value& v) {
+        kv::value r = v.eager(st);
+        if (const std::string_view s = out_of_line(r); !s.empty()) {
+            const std::string_view pooled = pool.append(s);
+            // always true, but gcc cannot see it and warns of the inline
+            // copy set_string() makes of short strings
+            if (pooled.size() > kv::value::INLINE_CAPACITY)
+                (void)r.set_string(pooled, pool.text());
+        }
+        return r;
+    };
+
+    std::vector<cache::section_record> sections;
+    sections.reserve(doc.sections.size());
+    for (const auto& s : doc.sections) {
+        const std::string_view sp = pool.append(s.path);
+        sections.push_back({
+            pool.offset_of(sp),
+            static_cast<std::uint32_t>(sp.size()),
+            static_cast<std::uint32_t>(s.name.size()),
+            s.parent,
+            s.first_child,
+            s.next_sibling,
+            s.first_kv,
+            s.kv_count
+        });
+    }
+
+    std::vector<cache::key_record> key_records;
+    key_records.reserve(keys.size());
+    for (const auto& k : keys) {
+        const std::string_view kp = pool.append(k);
+        key_records.push_back({ 
+            pool.offset_of(kp), 
+            static_cast<std::uint32_t>(kp.size()),
+            util::hash_bytes(k)
+        });
+    }
+
+    std::vector<cache::kv_record> kvs;
+    kvs.reserve(doc.kvs.size());
+    for (const auto& p : doc.kvs)
+        kvs.push_back({ key_of[p.sym], 0, relocate(p.val) });
+
+    std::vector<kv::value> elements;
+    elements.reserve(st.elements.size());
+    for (const auto& v : st.elements)
+        elements.push_back(relocate(v));
+
+    const auto section_slots = doc.section_index.slots();
+    const auto kv_slots = same_ids ? 
+        doc.kv_index.slots() : 
+        std::span<const hash_index::slot>{};
+    const auto key_slots = doc.key_index.slots();
+
+    cache::header h{};
+    h.magic = CACHE_MAGIC;
+    h.version = CACHE_VERSION;
+    h.byte_order = CACHE_BYTE_ORDER;
+    h.value_size = sizeof(kv::value);
+    h.float_size = sizeof(kv::float_type);
+    h.source = key;
+    h.section_count = sections.size();
+    h.key_count = key_records.size();
+    h.kv_count = kvs.size();
+    h.element_count = elements.size();
+    h.int_count = st.ints.size();
+    h.uint_count = st.uints.size();
+    h.float_count = st.floats.size();
+    h.section_slots = section_slots.size();
+    h.kv_slots = kv_slots.size();
+    h.key_slots = key_slots.size();
+    h.pool_size = pool.str().size();
+    h.checksum = cache::header_checksum(h);
+
+    const std::string tmp = util::format("{}.{:x}.tmp", path, 
+                                         std::random_device{}());
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f)
+            throw std::runtime_error("failed to open cache file.");
+
+        // each table is padded with zeros to where the layout has it
+        const cache::layout at = cache::layout_of(h);
+        std::size_t written = 0;
+        auto put = [&](std::size_t offset, const auto* p, std::size_t n) {
+            static constexpr std::array<char, cache::ALIGNMENT> zeros{};
+            f.write(zeros.data(), 
+                    static_cast<std::streamsize>(offset - written));
+            f.write(reinterpret_cast<const char*>(p),
+                    static_cast<std::streamsize>(n * sizeof(*p)));
+            written = offset + n * sizeof(*p);
+        };
+        put(0, &h, 1);
+        put(at.sections, sections.data(), sections.size());
+        put(at.keys, key_records.data(), key_records.size());
+        put(at.kvs, kvs.data(), kvs.size());
+        put(at.elements, elements.data(), elements.size());
+        put(at.ints, st.ints.data(), st.ints.size());
+        put(at.uints, st.uints.data(), st.uints.size());
+        put(at.floats, st.floats.data(), st.floats.size());
+        put(at.section_slots, section_slots.data(), section_slots.size());
+        put(at.kv_slots, kv_slots.data(), kv_slots.size());
+        put(at.key_slots, key_slots.data(), key_slots.size());
+        put(at.pool, pool.str().data(), pool.str().size());
+
+        if (!f.flush()) {
+            f.close();
+            std::filesystem::remove(tmp, ec);
+            throw std::runtime_error("error writing to cache file.");
+        }
+    }
+
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        throw std::runtime_error("failed to replace cache file.");
+    }
+}
+
+// loads the cache at path if it was compiled from the current contents of
+// source. the file is mapped and becomes the document's buffer. its array
+// pools and indexes are read where they lie in it; sections and kvs, which
+// hold views, are built from its records in one pass. every index and 
+// offset is checked, and each distinct key hashed to check its saved 
+// hash, but nothing is tokenized or converted. the keys are interned in
+// symbols, or in a new table if it is null, only if the cache is used.
+NO_DISCARD inline std::expected<document, CACHE_ERROR>
+load_cache(std::string_view source,
+           std::string_view path,
+           std::pmr::memory_resource* upstream =
+               std::pmr::get_default_resource(),
+           std::shared_ptr<symbol_table> symbols = nullptr) {
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec))
+        return std::unexpected(CACHE_ERROR::MISSING);
+
+    document doc(upstream);
+    doc.symbols = symbols ? std::move(symbols) : 
+                            std::make_shared<symbol_table>();
+    try {
+        doc.buffer = load_file(path);
+    } catch (const std::exception&) {
+        return std::unexpected(CACHE_ERROR::MISSING);
+    }
+    const std::string_view buf = doc.buffer.view();
+
+    cache::header h;
+    if (!cache::read_record(buf, 0, h) ||
+        h.magic != CACHE_MAGIC ||
+        h.version != CACHE_VERSION ||
+        h.byte_order != CACHE_BYTE_ORDER ||
+        h.value_size != sizeof(kv::value) ||
+        h.float_size != sizeof(kv::float_type) ||
+        h.checksum != cache::header_checksum(h))
+        return std::unexpected(CACHE_ERROR::CORRUPT);
+
+    // the counts are checked before they are multiplied out
+    if (h.section_count == 0 ||
+        h.section_count >= NO_INDEX || h.key_count >= NO_INDEX ||
+        h.kv_count >= NO_INDEX || h.element_count >= NO_INDEX || 
+        h.int_count >= NO_INDEX || h.uint_count >= NO_INDEX || 
+        h.float_count >= NO_INDEX || 
+        h.section_slots >= NO_INDEX || h.kv_slots >= NO_INDEX || 
+        h.key_slots >= NO_INDEX || h.pool_size >= NO_INDEX)
+        return std::unexpected(CACHE_ERROR::CORRUPT);
+
+    // a mapping, or a buffer from new, is always aligned well enough
+    const cache::layout at = cache::layout_of(h);
+    if (at.size != buf.size() ||
+        reinterpret_cast<std::uintptr_t>(buf.data()) % cache::ALIGNMENT != 0)
+        return std::unexpected(CACHE_ERROR::CORRUPT);
+
+    // the cache is intact; now make sure it describes the source as it is
+    const std::int64_t mtime = cache::modification_time(source, ec);
+    if (ec || std::filesystem::file_size(source, ec) != h.source.size || ec)
+        return std::unexpected(CACHE_ERROR::STALE);
+    if (mtime != h.source.mtime) {
+        try {
+            const file_buffer now = load_file(source);
+            if (util::hash_bytes(now.view()) != h.source.hash)
+                return std::unexpected(CACHE_ERROR::STALE);
+        } catch (const std::exception&) {
+            return std::unexpected(CACHE_ERROR::STALE);
+        }
+    }
+
+    doc.text = buf.substr(at.pool);
+    doc.arrays.borrow({
+        doc.text,
+        cache::table_at<kv::value>(buf, at.elements, h.element_count),
+        cache::table_at<std::intmax_t>(buf, at.ints, h.int_count),
+        cache::table_at<std::size_t>(buf, at.uints, h.uint_count),
+        cache::table_at<kv::float_type>(buf, at.floats, h.float_count)
+    });
+
+    const kv::storage st = doc.storage();
+    auto in_pool = [&](std::uint32_t offset, std::uint32_t size) {
+        return offset <= doc.text.size() && size <= doc.text.size() - offset;
+    };
+    // lazy values are converted before they are written, and one read in
+    // place would be converted into the mapping
+    auto valid = [&](const kv::value& v) {
+        if (v.lazy())
+            return false;
+        switch (v.type) {
+        case KV_PAIR_VALUE::BOOL:
+        case KV_PAIR_VALUE::INT:
+        case KV_PAIR_VALUE::UINT:
+        case KV_PAIR_VALUE::FLOAT:
+            return true;
+        case KV_PAIR_VALUE::STRING: {
+            // longer strings than a value holds inline are in the pool
+            const auto s = v.as_string(st);
+            if (!s || s->size() <= kv::value::INLINE_CAPACITY)
+                return s.has_value();
+            const std::uintptr_t at = 
+                reinterpret_cast<std::uintptr_t>(s->data()) -
+                reinterpret_cast<std::uintptr_t>(doc.text.data());
+            return at <= doc.text.size() && s->size() <= doc.text.size() - at;
+        }
+        case KV_PAIR_VALUE::ARRAY:
+            return v.array_size(st).has_value();
+        case KV_PAIR_VALUE::ERR:
+            // a lazy value that failed to convert
+            return true;
+        default:
+            return false;
+        }
+    };
+    // arrays do not nest
+    for (const auto& v : st.elements) {
+        if (v.type == KV_PAIR_VALUE::ARRAY || !valid(v))
+            return std::unexpected(CACHE_ERROR::CORRUPT);
+    }
+    auto section_ok = [&](section_id id) {
+        return id == NO_INDEX || id < h.section_count;
+    };
+
+    const auto section_records = 
+        cache::table_at<cache::section_record>(buf, at.sections, h.section_count);
+    doc.sections.resize(h.section_count);
+    for (std::size_t i = 0; i < h.section_count; ++i) {
+        const cache::section_record& r = section_records[i];
+        if (!in_pool(r.path_offset, r.path_size) || r.name_size > r.path_size ||
+            !section_ok(r.parent) || !section_ok(r.first_child) ||
+            !section_ok(r.next_sibling) ||
+            r.first_kv > h.kv_count || r.kv_count > h.kv_count - r.first_kv)
+            return std::unexpected(CACHE_ERROR::CORRUPT);
+
+        section& s = doc.sections[i];
+        s.path = doc.text.substr(r.path_offset, r.path_size);
+        s.name = s.path.substr(r.path_size - r.name_size);
+        s.parent = r.parent;
+        s.first_child = r.first_child;
+        s.next_sibling = r.next_sibling;
+        s.first_kv = r.first_kv;
+        s.kv_count = r.kv_count;
+    }
+
+    // a key's saved hash is checked rather than trusted: one that did not
+    // match its name would give that name a second id in the symbols
+    const auto key_records = 
+        cache::table_at<cache::key_record>(buf, at.keys, h.key_count);
+    std::vector<std::string_view> keys(h.key_count);
+    std::vector<std::uint64_t> hashes(h.key_count);
+    for (std::size_t i = 0; i < h.key_count; ++i) {
+        const cache::key_record& r = key_records[i];
+        if (!in_pool(r.offset, r.size))
+            return std::unexpected(CACHE_ERROR::CORRUPT);
+
+        keys[i] = doc.text.substr(r.offset, r.size);
+        hashes[i] = util::hash_bytes(keys[i]);
+        if (hashes[i] != r.hash)
+            return std::unexpected(CACHE_ERROR::CORRUPT);
+    }
+
+    const auto kv_records = 
+        cache::table_at<cache::kv_record>(buf, at.kvs, h.kv_count);
+    doc.kvs.resize(h.kv_count);
+    for (std::size_t i = 0; i < h.kv_count; ++i) {
+        const cache::kv_record& r = kv_records[i];
+        if (r.key >= h.key_count || !valid(r.val))
+            return std::unexpected(CACHE_ERROR::CORRUPT);
+
+        doc.kvs[i].key = keys[r.key];
+        doc.kvs[i].val = r.val;
+    }
+
+    auto load_index = [&](hash_index& index,
+                          std::size_t offset,
+                          std::size_t n,
+                          std::size_t count) {
+        const auto slots = 
+            cache::table_at<hash_index::slot>(buf, offset, n);
+        for (const auto& x : slots) {
+            if (x.index != hash_index::EMPTY && x.index >= count)
+                return false;
+        }
+        return index.borrow(slots);
+    };
+    if (!load_index(doc.section_index, at.section_slots, h.section_slots,
+                    h.section_count) ||
+        !load_index(doc.key_index, at.key_slots, h.key_slots, h.kv_count) ||
+        (h.kv_slots != 0 &&
+         !load_index(doc.kv_index, at.kv_slots, h.kv_slots, h.kv_count)))
+        return std::unexpected(CACHE_ERROR::CORRUPT);
+
+    // the cache is accepted. only now are its keys added to symbols, which
+    // may be shared and outlive it.
+    std::vector<symbol_id> syms(h.key_count);
+    doc.symbols->intern(keys, hashes, syms);
+    bool same_ids = true;
+    for (std::size_t i = 0; i < h.key_count; ++i)
+        same_ids = same_ids && syms[i] == i;
+    for (std::size_t i = 0; i < h.kv_count; ++i)
+        doc.kvs[i].sym = syms[kv_records[i].key];
+    if (!same_ids || h.kv_slots == 0)
+        doc.build_kv_index();
+
+    return doc;
+}
+
+// loads source through the cache at cache_path, falling back to parsing it
+// when the cache is missing, stale or corrupt. after a fallback the cache
+// is rewritten; failing to do so is not an error.
+NO_DISCARD inline document
+parse_file_cached(std::string_view source,
+                  std::string_view cache_path,
+                  const parse_options& o = {}) {
+    auto cached = load_cache(source, cache_path, o.resource != nullptr ?
+        o.resource :
+        std::pmr::get_default_resource(), o.symbols);
+    if (cached)
+        return std::move(*cached);
+
+    util::dlog("parse_file_cached: not using cache (e={}).",
+               static_cast<int>(cached.error()));
+    document doc = parse_file(source, o);
+    try {
+        write_cache(doc, source, cache_path);
+    } catch (const std::exception& e) {
+        util::dlog("parse_file_cached: failed to write cache ({}).", e.what());
+    }
+    return doc;
+}
@@ -0,0 +1,2470 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+#include <charconv>
+#include <limits>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <concepts>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <expected>
+#include <type_traits>
+
+#include "util.hpp"
+#include "loader.hpp"
+#include "hash_index.hpp"
+#include "symbols.hpp"
+#include "structural.hpp"
+#include "parallel.hpp"
+#include "stats.hpp"
+
+#ifndef NO_DISCARD
+#   define NO_DISCARD [[nodiscard]]
+#endif
+
+inline static constexpr std::array<char, 2> COMMENT_CHARS = { '#', ';' };
+
+enum class KV_PAIR_VALUE : int8_t {
+    ERR  = -1,
+    BOOL =  1,
+    INT,
+    UINT,
+    FLOAT,
+    STRING,
+    ARRAY
+};
+inline static const std::map<KV_PAIR_VALUE, std::string_view> 
+KV_PAIR_VALUE_STR = 
+{
+    { KV_PAIR_VALUE::ERR,    "ERR"    },
+    { KV_PAIR_VALUE::BOOL,   "BOOL"   },
+    { KV_PAIR_VALUE::INT,    "INT"    },
+    { KV_PAIR_VALUE::UINT,   "UINT"   },
+    { KV_PAIR_VALUE::FLOAT,  "FLOAT"  },
+    { KV_PAIR_VALUE::STRING, "STRING" },
+    { KV_PAIR_VALUE::ARRAY,  "ARRAY"  }
+};
+
+// reasons a typed lookup can fail
+enum class LOOKUP_ERROR : int8_t {
+    NO_SUCH_SECTION = -1,
+    NO_SUCH_KEY     = -2,
+    WRONG_TYPE      = -3,
+    OUT_OF_RANGE    = -4,
+    INVALID_VALUE   = -5   // a lazily parsed value that failed to convert
+};
+
+namespace kv {
+
+// floats are stored as double, or as long double if CONFPARSE_LONG_DOUBLE
+// is defined, which doubles the size of every value on most platforms
+#ifdef CONFPARSE_LONG_DOUBLE
+using float_type = long double;
+#else
+using float_type = double;
+#endif
+
+struct value;
+
+// what the offsets held by values refer to: the text they were parsed from
+// and, for arrays, the pools holding their elements. arrays of one numeric
+// type are packed into ints, uints or floats; any other array is a run of
+// element values.
+struct storage {
+    std::string_view text;
+    std::span<const value> elements;
+    std::span<const std::intmax_t> ints;
+    std::span<const std::size_t> uints;
+    std::span<const float_type> floats;
+
+    // the packed pool of T
+    template<typename T>
+    NO_DISCARD constexpr std::span<const T> packed() const noexcept {
+        if constexpr (std::same_as<T, std::intmax_t>) {
+            return ints;
+        } else if constexpr (std::same_as<T, std::size_t>) {
+            return uints;
+        } else {
+            static_assert(std::same_as<T, float_type>,
+                          "storage::packed(): unsupported type.");
+            return floats;
+        }
+    }
+};
+
+// converts the raw token of a lazy value into v. returns false if it is
+// invalid.
+NO_DISCARD inline bool decode_lazy(std::string_view raw, value& v) noexcept;
+
+// a value in two words, a word being 8 bytes or the size of float_type if 
+// that is larger. after the type tag comes either a string of up to 14 
+// bytes (with 8-byte words) stored inline, or a one-word payload holding a
+// scalar or the offset and size of a longer string (within storage::text)
+// or of an array (within storage::elements, or the packed pool of its 
+// element type, which is kept in the first byte).
+//
+// a lazy value holds only the offset and size of its raw token, with type 
+// guessed from the token's first character. the first typed access converts
+// it and caches the result in the payload; one thread wins the right to 
+// store it and publishes it with the state in size_, so concurrent readers 
+// of a shared document neither race nor wait. kind() is always exact.
+struct alignas(std::bit_ceil(std::max(sizeof(float_type), sizeof(std::uint64_t)))) 
+value {
+    using self_type = value;
+
+    static constexpr std::size_t WORD = 
+        std::bit_ceil(std::max(sizeof(float_type), sizeof(std::uint64_t)));
+    static constexpr std::size_t INLINE_CAPACITY = 2 * WORD - 2;
+    // raw tokens longer than this are converted when parsed
+    static constexpr std::size_t MAX_LAZY = 0xffff;
+
+    constexpr value() noexcept = default;
+
+    constexpr self_type& operator=(bool b) noexcept {
+        return set(KV_PAIR_VALUE::BOOL, b ? 1 : 0);
+    }
+
+    constexpr self_type& operator=(std::size_t i) noexcept {
+        return set(KV_PAIR_VALUE::UINT, i);
+    }
+
+    constexpr self_type& operator=(std::intmax_t i) noexcept {
+        return set(KV_PAIR_VALUE::INT, std::bit_cast<std::uint64_t>(i));
+    }
+
+    constexpr self_type& operator=(float_type f) noexcept {
+        type = KV_PAIR_VALUE::FLOAT;
+        size_ = 0;
+        const auto b = std::bit_cast<float_bytes>(f);
+        word w{};
+        std::copy(b.begin(), b.end(), w.begin());
+        put(w);
+        return *this;
+    }
+
+    // s is copied if it fits inline, otherwise it must lie within text and 
+    // is stored as its offset. returns false if the offset or size does not
+    // fit in 32 bits, leaving the value unchanged.
+    constexpr bool 
+    set_string(std::string_view s, std::string_view text) noexcept {
+        if (s.size() <= INLINE_CAPACITY) {
+            type = KV_PAIR_VALUE::STRING;
+            size_ = static_cast<std::uint8_t>(s.size());
+            std::copy(s.begin(), s.end(), chars_);
+            return true;
+        }
+        if (!set_ref(static_cast<std::size_t>(s.data() - text.data()), 
+                     s.size()))
+            return false;
+        type = KV_PAIR_VALUE::STRING;
+        return true;
+    }
+
+    // elements [offset, offset + count) of storage::elements, or with
+    // packed INT, UINT or FLOAT of the packed pool of that type
+    constexpr bool set_array(std::size_t offset, 
+                             std::size_t count,
+                             KV_PAIR_VALUE packed = KV_PAIR_VALUE::ERR) noexcept {
+        if (!set_ref(offset, count))
+            return false;
+        type = KV_PAIR_VALUE::ARRAY;
+        chars_[0] = static_cast<char>(packed);
+        return true;
+    }
+
+    // defers converting raw, which must lie within text, to the first 
+    // access. returns false if raw is empty, longer than MAX_LAZY or at an
+    // offset that does not fit in 32 bits, leaving the value unchanged.
+    constexpr bool 
+    set_lazy(std::string_view raw, std::string_view text) noexcept {
+        const auto offset = static_cast<std::size_t>(raw.data() - text.data());
+        // arrays need somewhere to put their elements, so are never lazy
+        if (raw.empty() || raw.front() == '[' || raw.size() > MAX_LAZY || 
+            offset > std::numeric_limits<std::uint32_t>::max())
+            return false;
+        type = guess(raw.front());
+        size_ = LAZY;
+        set_raw(offset, raw.size());
+        return true;
+    }
+
+    // true if the value was parsed lazily, whether or not it has been
+    // converted since
+    NO_DISCARD constexpr bool lazy() const noexcept {
+        return IS_LAZY(state());
+    }
+
+    // the type of the value, converting it first if it is lazy
+    NO_DISCARD constexpr KV_PAIR_VALUE 
+    kind(const storage& st) const noexcept {
+        return resolve(st).type;
+    }
+
+    NO_DISCARD constexpr std::expected<bool, LOOKUP_ERROR> 
+    as_bool(const storage& st) const noexcept {
+        const resolved r = resolve(st);
+        if (r.type != KV_PAIR_VALUE::BOOL)
+            return std::unexpected(mismatch(r.type));
+        return bits_of(r.w) != 0;
+    }
+
+    NO_DISCARD constexpr std::expected<std::size_t, LOOKUP_ERROR> 
+    as_uint(const storage& st) const noexcept {
+        const resolved r = resolve(st);
+        if (r.type != KV_PAIR_VALUE::UINT)
+            return std::unexpected(mismatch(r.type));
+        return static_cast<std::size_t>(bits_of(r.w));
+    }
+
+    NO_DISCARD constexpr std::expected<std::intmax_t, LOOKUP_ERROR> 
+    as_int(const storage& st) const noexcept {
+        const resolved r = resolve(st);
+        if (r.type != KV_PAIR_VALUE::INT)
+            return std::unexpected(mismatch(r.type));
+        return std::bit_cast<std::intmax_t>(bits_of(r.w));
+    }
+
+    NO_DISCARD constexpr std::expected<float_type, LOOKUP_ERROR> 
+    as_float(const storage& st) const noexcept {
+        const resolved r = resolve(st);
+        if (r.type != KV_PAIR_VALUE::FLOAT)
+            return std::unexpected(mismatch(r.type));
+        float_bytes b{};
+        std::copy_n(r.w.begin(), b.size(), b.begin());
+        return std::bit_cast<float_type>(b);
+    }
+
+    // inline strings are views into the value itself, so they are valid for
+    // as long as it is. lazy strings are read from their raw token.
+    NO_DISCARD constexpr std::expected<std::string_view, LOOKUP_ERROR> 
+    as_string(const storage& st) const noexcept {
+        const resolved r = resolve(st);
+        if (r.type != KV_PAIR_VALUE::STRING)
+            return std::unexpected(mismatch(r.type));
+        if (r.state != REF && !IS_LAZY(r.state))
+            return std::string_view(chars_, r.state);
+
+        const auto [offset, size] = IS_LAZY(r.state) ? raw() : ref();
+        if (offset > st.text.size() || size > st.text.size() - offset)
+            return std::unexpected(LOOKUP_ERROR::OUT_OF_RANGE);
+        const std::string_view s = st.text.substr(offset, size);
+        // the converter accepted a quoted token, so it is closed
+        if (IS_LAZY(r.state) && s.front() == '"')
+            return s.substr(1, s.size() - 2);
+        return s;
+    }
+
+    // the elements of an array that is not packed. an empty array can be
+    // read as any kind of array.
+    NO_DISCARD constexpr std::expected<std::span<const value>, LOOKUP_ERROR> 
+    as_array(const storage& st) const noexcept {
+        return elements_of(st, st.elements, KV_PAIR_VALUE::ERR);
+    }
+
+    // the elements of an array packed as T: std::intmax_t for INT,
+    // std::size_t for UINT or float_type for FLOAT, in place
+    template<typename T>
+    NO_DISCARD constexpr std::expected<std::span<const T>, LOOKUP_ERROR> 
+    as_packed(const storage& st) const noexcept {
+        constexpr KV_PAIR_VALUE t = 
+            std::same_as<T, std::intmax_t> ? KV_PAIR_VALUE::INT :
+            std::same_as<T, std::size_t> ? KV_PAIR_VALUE::UINT :
+            KV_PAIR_VALUE::FLOAT;
+        return elements_of(st, st.packed<T>(), t);
+    }
+
+    // what an array's elements are packed as, or ERR if they are values
+    NO_DISCARD constexpr KV_PAIR_VALUE packed_type() const noexcept {
+        return static_cast<KV_PAIR_VALUE>(chars_[0]);
+    }
+
+    NO_DISCARD constexpr std::expected<std::size_t, LOOKUP_ERROR>
+    array_size(const storage& st) const noexcept {
+        auto size_of = [](const auto& e) 
+            -> std::expected<std::size_t, LOOKUP_ERROR> {
+            if (!e)
+                return std::unexpected(e.error());
+            return e->size();
+        };
+        switch (packed_type()) {
+        case KV_PAIR_VALUE::INT:
+            return size_of(as_packed<std::intmax_t>(st));
+        case KV_PAIR_VALUE::UINT:
+            return size_of(as_packed<std::size_t>(st));
+        case KV_PAIR_VALUE::FLOAT:
+            return size_of(as_packed<float_type>(st));
+        default:
+            return size_of(as_array(st));
+        }
+    }
+
+    // element i of an array of at least i + 1 elements, unpacked
+    NO_DISCARD constexpr value 
+    element(const storage& st, std::size_t i) const noexcept {
+        value v;
+        const std::size_t at = ref().first + i;
+        switch (packed_type()) {
+        case KV_PAIR_VALUE::INT:
+            return v = st.ints[at];
+        case KV_PAIR_VALUE::UINT:
+            return v = st.uints[at];
+        case KV_PAIR_VALUE::FLOAT:
+            return v = st.floats[at];
+        default:
+            return st.elements[at];
+        }
+    }
+
+    // a copy that needs no conversion: a lazy value is converted and its 
+    // string, if any, stored as it would have been when parsed
+    NO_DISCARD constexpr value eager(const storage& st) const noexcept {
+        if (!lazy())
+            return *this;
+
+        value v;
+        const resolved r = resolve(st);
+        if (r.type == KV_PAIR_VALUE::STRING) {
+            if (const auto s = as_string(st); !s || !v.set_string(*s, st.text))
+                v.type = KV_PAIR_VALUE::ERR;
+        } else if (r.type != KV_PAIR_VALUE::ERR) {
+            v.type = r.type;
+            v.put(r.w);
+        }
+        return v;
+    }
+
+    // a copy whose offsets into storage::text are moved by delta, for text
+    // that has moved to another buffer. safe while others read this value.
+    NO_DISCARD constexpr value shifted(std::ptrdiff_t delta) const noexcept {
+        const std::uint8_t s = state();
+        if (!IS_LAZY(s)) {
+            value v = *this;
+            if (s == REF && type == KV_PAIR_VALUE::STRING) {
+                const auto [offset, size] = ref();
+                (void)v.set_ref(offset + delta, size);
+            }
+            return v;
+        }
+
+        // the raw token never changes once set, and the payload is only 
+        // read once its conversion has been published
+        value v;
+        v.type = type;
+        v.size_ = s == BUSY ? LAZY : s;
+        if (s != LAZY && s != BUSY)
+            v.put(payload());
+        const auto [offset, size] = raw();
+        v.set_raw(offset + delta, size);
+        return v;
+    }
+
+    KV_PAIR_VALUE type = KV_PAIR_VALUE::ERR;
+
+private:
+    // size_ of a string or array held by reference
+    static constexpr std::uint8_t REF = 0xff;
+    // size_ of a lazy value: not yet converted, being converted by one 
+    // thread, or converted, DECODED plus the type (DECODED alone for ERR)
+    static constexpr std::uint8_t LAZY = 0xfe;
+    static constexpr std::uint8_t BUSY = 0xfd;
+    static constexpr std::uint8_t DECODED = 0xe0;
+    // the payload is the second word, chars_[WORD - 2, 2 * WORD - 2); a 
+    // lazy value's raw token is described by chars_[0, 6)
+    static constexpr std::size_t PAYLOAD = WORD - 2;
+    static constexpr std::size_t RAW = 6;
+
+    using word = std::array<char, WORD>;
+    using float_bytes = std::array<unsigned char, sizeof(float_type)>;
+
+    struct resolved {
+        KV_PAIR_VALUE type;
+        word w;
+        std::uint8_t state;
+    };
+
+    NO_DISCARD static constexpr bool IS_LAZY(std::uint8_t s) noexcept {
+        return s >= DECODED && s != REF;
+    }
+
+    NO_DISCARD static constexpr LOOKUP_ERROR mismatch(KV_PAIR_VALUE t) noexcept {
+        return t == KV_PAIR_VALUE::ERR ? 
+            LOOKUP_ERROR::INVALID_VALUE : 
+            LOOKUP_ERROR::WRONG_TYPE;
+    }
+
+    template<typename T>
+    NO_DISCARD constexpr std::expected<std::span<const T>, LOOKUP_ERROR> 
+    elements_of(const storage& st, 
+                std::span<const T> pool, 
+                KV_PAIR_VALUE packed) const noexcept {
+        const resolved r = resolve(st);
+        if (r.type != KV_PAIR_VALUE::ARRAY)
+            return std::unexpected(mismatch(r.type));
+        const auto [offset, size] = ref();
+        if (size == 0)
+            return std::span<const T>{};
+        if (packed_type() != packed)
+            return std::unexpected(LOOKUP_ERROR::WRONG_TYPE);
+        if (offset > pool.size() || size > pool.size() - offset)
+            return std::unexpected(LOOKUP_ERROR::OUT_OF_RANGE);
+        return pool.subspan(offset, size);
+    }
+
+    // cheap enough to make for every value; only quoted strings are certain
+    NO_DISCARD static constexpr KV_PAIR_VALUE guess(char c) noexcept {
+        switch (c | 0x20) {
+        case 't':
+        case 'f':
+            return KV_PAIR_VALUE::BOOL;
+        case '-':
+            return KV_PAIR_VALUE::INT;
+        case '.':
+            return KV_PAIR_VALUE::FLOAT;
+        default:
+            return (c >= '0' && c <= '9') || c == '+' ?
+                KV_PAIR_VALUE::UINT :
+                KV_PAIR_VALUE::STRING;
+        }
+    }
+
+    // size_, which is only ever changed by the conversion of a lazy value
+    NO_DISCARD constexpr std::uint8_t state() const noexcept {
+        if (std::is_constant_evaluated())
+            return size_;
+        return std::atomic_ref(const_cast<std::uint8_t&>(size_))
+            .load(std::memory_order_acquire);
+    }
+
+    NO_DISCARD constexpr resolved resolve(const storage& st) const noexcept {
+        const std::uint8_t s = state();
+        if (!IS_LAZY(s))
+            return { type, payload(), s };
+        if (s != LAZY && s != BUSY) {
+            return { 
+                static_cast<KV_PAIR_VALUE>(s == DECODED ? -1 : s - DECODED),
+                payload(), 
+                s 
+            };
+        }
+
+        resolved r{ KV_PAIR_VALUE::ERR, {}, s };
+        const auto [offset, size] = raw();
+        if (offset > st.text.size() || size > st.text.size() - offset)
+            return r;
+        if (value v; decode_lazy(st.text.substr(offset, size), v)) {
+            r.type = v.type;
+            r.w = v.payload();
+        }
+
+        // whoever moves LAZY to BUSY stores the result; anyone else keeps
+        // their own copy of it
+        std::uint8_t expected = LAZY;
+        if (!std::is_constant_evaluated() &&
+            std::atomic_ref(const_cast<std::uint8_t&>(size_))
+                .compare_exchange_strong(expected, BUSY,
+                                         std::memory_order_relaxed)) {
+            const_cast<value*>(this)->put(r.w);
+            std::atomic_ref(const_cast<std::uint8_t&>(size_)).store(
+                r.type == KV_PAIR_VALUE::ERR ? 
+                    DECODED : 
+                    static_cast<std::uint8_t>(
+                        DECODED + static_cast<int>(r.type)),
+                std::memory_order_release);
+        }
+        return r;
+    }
+
+    // integers and references are kept in the first 8 bytes of the word
+    NO_DISCARD static constexpr word to_word(std::uint64_t p) noexcept {
+        const auto b = std::bit_cast<std::array<char, 8>>(p);
+        word w{};
+        std::copy(b.begin(), b.end(), w.begin());
+        return w;
+    }
+
+    NO_DISCARD static constexpr std::uint64_t bits_of(const word& w) noexcept {
+        std::array<char, 8> b{};
+        std::copy_n(w.begin(), b.size(), b.begin());
+        return std::bit_cast<std::uint64_t>(b);
+    }
+
+    constexpr void put(const word& w) noexcept {
+        std::copy(w.begin(), w.end(), chars_ + PAYLOAD);
+    }
+
+    constexpr self_type& set(KV_PAIR_VALUE t, std::uint64_t p) noexcept {
+        type = t;
+        size_ = 0;
+        put(to_word(p));
+        return *this;
+    }
+
+    NO_DISCARD constexpr word payload() const noexcept {
+        word w{};
+        std::copy_n(chars_ + PAYLOAD, w.size(), w.begin());
+        return w;
+    }
+
+    constexpr bool set_ref(std::size_t offset, std::size_t size) noexcept {
+        constexpr std::size_t max = std::numeric_limits<std::uint32_t>::max();
+        if (offset > max || size > max)
+            return false;
+        set(type, (static_cast<std::uint64_t>(size) << 32) | offset);
+        size_ = REF;
+        return true;
+    }
+
+    NO_DISCARD constexpr std::pair<std::size_t, std::size_t> 
+    ref() const noexcept {
+        const std::uint64_t p = bits_of(payload());
+        return { static_cast<std::uint32_t>(p), p >> 32 };
+    }
+
+    // a 32-bit offset and 16-bit size, little-endian
+    constexpr void set_raw(std::size_t offset, std::size_t size) noexcept {
+        const std::uint64_t r = (static_cast<std::uint64_t>(size) << 32) | 
+                                static_cast<std::uint32_t>(offset);
+        for (std::size_t i = 0; i < RAW; ++i)
+            chars_[i] = static_cast<char>(r >> (8 * i));
+    }
+
+    NO_DISCARD constexpr std::pair<std::size_t, std::size_t> 
+    raw() const noexcept {
+        std::uint64_t r = 0;
+        for (std::size_t i = 0; i < RAW; ++i) {
+            r |= static_cast<std::uint64_t>(
+                static_cast<unsigned char>(chars_[i])) << (8 * i);
+        }
+        return { static_cast<std::uint32_t>(r), r >> 32 };
+    }
+
+    std::uint8_t size_ = 0;  // length of an inline string, REF or lazy state
+    char chars_[INLINE_CAPACITY] = {};
+};
+
+static_assert(sizeof(value) == 2 * value::WORD, "kv::value must stay two words.");
+static_assert(std::is_trivially_copyable_v<value>);
+
+struct pair {
+    using self_type = pair;
+    using key_type = std::string_view;
+    using value_type = value;
+
+    pair() = default;
+    pair(const self_type&) = default;
+    pair(self_type&&) = default;
+    ~pair() = default;
+
+    self_type& operator=(const self_type&) = default;
+    self_type& operator=(self_type&&) = default;
+
+    key_type key;
+    symbol_id sym = NO_SYMBOL;  // key, interned in the document's symbols
+    value_type val;
+};
+
+// converts v to T where its type allows: bool from BOOL, integers from INT 
+// or UINT when in range, floating point from FLOAT, INT or UINT, 
+// std::string_view from STRING, std::span<const value> from an ARRAY of 
+// values and std::span<const std::intmax_t>, std::span<const std::size_t>
+// or std::span<const float_type> from an ARRAY packed as that type
+template<typename T>
+NO_DISCARD constexpr std::expected<T, LOOKUP_ERROR> 
+value_as(const value& v, const storage& st) noexcept {
+    if constexpr (std::same_as<T, bool>) {
+        return v.as_bool(st);
+    } else if constexpr (std::integral<T>) {
+        if (const auto u = v.as_uint(st)) {
+            if (!std::in_range<T>(*u))
+                return std::unexpected(LOOKUP_ERROR::OUT_OF_RANGE);
+            return static_cast<T>(*u);
+        }
+        const auto i = v.as_int(st);
+        if (!i)
+            return std::unexpected(i.error());
+        if (!std::in_range<T>(*i))
+            return std::unexpected(LOOKUP_ERROR::OUT_OF_RANGE);
+        return static_cast<T>(*i);
+    } else if constexpr (std::floating_point<T>) {
+        if (const auto f = v.as_float(st))
+            return static_cast<T>(*f);
+        if (const auto u = v.as_uint(st))
+            return static_cast<T>(*u);
+        const auto i = v.as_int(st);
+        if (!i)
+            return std::unexpected(i.error());
+        return static_cast<T>(*i);
+    } else if constexpr (std::same_as<T, std::span<const value>>) {
+        return v.as_array(st);
+    } else if constexpr (std::same_as<T, std::span<const std::intmax_t>> ||
+                         std::same_as<T, std::span<const std::size_t>> ||
+                         std::same_as<T, std::span<const float_type>>) {
+        return v.template as_packed<typename T::value_type>(st);
+    } else {
+        static_assert(std::same_as<T, std::string_view>, 
+                      "value_as(): unsupported type.");
+        return v.as_string(st);
+    }
+}
+
+// a value together with the storage its offsets refer to
+struct value_ref {
+    const value* v = nullptr;
+    storage st;
+
+    NO_DISCARD constexpr KV_PAIR_VALUE type() const noexcept { 
+        return v->kind(st); 
+    }
+
+    template<typename T>
+    NO_DISCARD constexpr std::expected<T, LOOKUP_ERROR> as() const noexcept {
+        return value_as<T>(*v, st);
+    }
+};
+
+// compares what two values hold rather than how they are stored, so equal
+// strings are equal whether they are inline or at different offsets. floats
+// are equal if they are the same number with the same sign, or both NaN, so
+// that an unchanged NaN compares equal.
+NO_DISCARD constexpr bool
+values_equal(const value_ref& a, const value_ref& b) noexcept {
+    if (a.type() != b.type())
+        return false;
+
+    switch (a.type()) {
+    case KV_PAIR_VALUE::BOOL:
+        return *a.v->as_bool(a.st) == *b.v->as_bool(b.st);
+    case KV_PAIR_VALUE::INT:
+        return *a.v->as_int(a.st) == *b.v->as_int(b.st);
+    case KV_PAIR_VALUE::UINT:
+        return *a.v->as_uint(a.st) == *b.v->as_uint(b.st);
+    case KV_PAIR_VALUE::FLOAT: {
+        const float_type x = *a.v->as_float(a.st);
+        const float_type y = *b.v->as_float(b.st);
+        return x == y ? std::signbit(x) == std::signbit(y) : x != x && y != y;
+    }
+    case KV_PAIR_VALUE::STRING:
+        return a.as<std::string_view>() == b.as<std::string_view>();
+    case KV_PAIR_VALUE::ARRAY: {
+        const auto n = a.v->array_size(a.st);
+        if (!n || n != b.v->array_size(b.st))
+            return false;
+        for (std::size_t i = 0; i < *n; ++i) {
+            const value x = a.v->element(a.st, i);
+            const value y = b.v->element(b.st, i);
+            if (!values_equal({ &x, a.st }, { &y, b.st }))
+                return false;
+        }
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// the pools holding the elements of arrays, for a document or for a parse
+// that has yet to hand its arrays over to one
+struct array_pool {
+    explicit array_pool(
+        std::pmr::memory_resource* r = std::pmr::get_default_resource())
+        : elements(r),
+          ints(r),
+          uints(r),
+          floats(r)
+    {
+
+    }
+
+    std::pmr::vector<value> elements;
+    std::pmr::vector<std::intmax_t> ints;
+    std::pmr::vector<std::size_t> uints;
+    std::pmr::vector<float_type> floats;
+
+    NO_DISCARD storage storage_of(std::string_view text) const noexcept {
+        if (borrowing_) {
+            return { 
+                text, 
+                borrowed_.elements, 
+                borrowed_.ints, 
+                borrowed_.uints, 
+                borrowed_.floats 
+            };
+        }
+        return { text, elements, ints, uints, floats };
+    }
+
+    // reads the pools of st, kept elsewhere such as in a mapped cache file, 
+    // in place of the vectors, which are left empty. st's pools must 
+    // outlive this one, or the next clear(), and nothing may be adopted 
+    // into it meanwhile.
+    void borrow(const storage& st) noexcept {
+        clear();
+        borrowed_ = st;
+        borrowing_ = true;
+    }
+
+    NO_DISCARD bool empty() const noexcept {
+        const storage st = storage_of({});
+        return st.elements.empty() && st.ints.empty() && st.uints.empty() && 
+               st.floats.empty();
+    }
+
+    void clear() noexcept {
+        elements.clear();
+        ints.clear();
+        uints.clear();
+        floats.clear();
+        borrowed_ = {};
+        borrowing_ = false;
+    }
+
+    // v, with its elements copied here from the pools of from if it is an
+    // array. the offsets of out-of-line strings among them are moved by 
+    // delta, as by value::shifted(). throws std::length_error if a pool 
+    // outgrows 32-bit offsets.
+    NO_DISCARD value 
+    adopt(const value& v, const storage& from, std::ptrdiff_t delta = 0) {
+        if (v.type != KV_PAIR_VALUE::ARRAY)
+            return v;
+
+        value r;
+        auto append = [&](auto& pool, const auto& src, auto&& copy) {
+            const std::size_t at = pool.size();
+            if (src) {
+                for (const auto& x : *src)
+                    pool.push_back(copy(x));
+            }
+            if (!r.set_array(at, pool.size() - at, v.packed_type()))
+                throw std::length_error("too many array elements.");
+        };
+        auto same = [](const auto& x) { return x; };
+        switch (v.packed_type()) {
+        case KV_PAIR_VALUE::INT:
+            append(ints, v.as_packed<std::intmax_t>(from), same);
+            break;
+        case KV_PAIR_VALUE::UINT:
+            append(uints, v.as_packed<std::size_t>(from), same);
+            break;
+        case KV_PAIR_VALUE::FLOAT:
+            append(floats, v.as_packed<float_type>(from), same);
+            break;
+        default:
+            append(elements, v.as_array(from), [&](const value& x) {
+                return x.shifted(delta);
+            });
+            break;
+        }
+        return r;
+    }
+
+private:
+    storage borrowed_;
+    bool borrowing_ = false;
+};
+
+} // namespace kv
+
+// index of a section within document::sections
+using section_id = std::uint32_t;
+inline static constexpr std::uint32_t NO_INDEX = 0xffffffffU;
+
+// sections live in one flat array and refer to each other by index. the 
+// global section is sections[0] and has an empty name and path; [a.b.c] is
+// the child "c" of "a.b", and opening it creates "a" and "a.b" if needed.
+struct section {
+    std::string_view name;  // last component of path
+    std::string_view path;  // full dotted path
+    section_id parent = NO_INDEX;
+    section_id first_child = NO_INDEX;
+    section_id next_sibling = NO_INDEX;
+    // this section's kvs are document::kvs[first_kv, first_kv + kv_count)
+    std::uint32_t first_kv = 0;
+    std::uint32_t kv_count = 0;
+};
+
+template<class CharT> struct fmt::formatter<kv::value_ref, CharT> :
+    fmt::formatter<int, CharT> 
+{
+    template<typename FormatContext>
+    auto format(const kv::value_ref& r, FormatContext& fc) {
+        switch (r.type()) {
+        case KV_PAIR_VALUE::BOOL:
+            return fmt::format_to(fc.out(), "{}", *r.v->as_bool(r.st));
+        case KV_PAIR_VALUE::INT:
+            return fmt::format_to(fc.out(), "{}", *r.v->as_int(r.st));
+        case KV_PAIR_VALUE::UINT:
+            return fmt::format_to(fc.out(), "{}", *r.v->as_uint(r.st));
+        case KV_PAIR_VALUE::FLOAT:
+            return fmt::format_to(fc.out(), "{}", *r.v->as_float(r.st));
+        case KV_PAIR_VALUE::STRING: {
+            const auto s = r.as<std::string_view>();
+            if (!s)
+                throw std::invalid_argument("string outside its storage.");
+            return fmt::format_to(fc.out(), "{}", *s);
+        }
+        case KV_PAIR_VALUE::ARRAY: {
+            const auto n = r.v->array_size(r.st);
+            if (!n)
+                throw std::invalid_argument("array outside its storage.");
+            fc.advance_to(fmt::format_to(fc.out(), "["));
+            for (std::size_t i = 0; i < *n; ++i) {
+                if (i != 0)
+                    fc.advance_to(fmt::format_to(fc.out(), ", "));
+                const kv::value e = r.v->element(r.st, i);
+                fc.advance_to(format(kv::value_ref{ &e, r.st }, fc));
+            }
+            return fmt::format_to(fc.out(), "]");
+        }
+        case KV_PAIR_VALUE::ERR:
+            throw std::invalid_argument("cannot format error type.");
+        }
+        throw std::invalid_argument("cannot format invalid type.");
+    }
+};
+
+NO_DISCARD constexpr bool LINE_CONTAINS_KV(std::string_view s) noexcept {
+    return s.find('=') != std::string::npos;
+}
+
+NO_DISCARD constexpr int
+KV_STRING_CONTAINS_INVALID_WHITESPACE(std::string_view s) noexcept {
+    if (ERROR(LINE_CONTAINS_KV(s)))
+        return -1;
+
+    s = util::parse::remove_leading_and_trailing_whitespace(s);
+
+    const std::size_t eq_pos = s.find('=');
+
+    // if first whitespace is after eq_pos, there is no leading whitespace
+
+    const std::size_t key_end = s.find_first_of(" =");
+    std::string_view k = s.substr(0, key_end);
+    if (util::parse::STRING_CONTAINS_WHITESPACE(k))
+        return -2;
+
+    const std::size_t value_begin = s.find_first_not_of(" \n", eq_pos + 1);
+    if (value_begin == std::string::npos)
+        return -3;
+
+    std::size_t i = value_begin + 1;
+    if (s[value_begin] == '"') {
+        while ((i = s.find('"', i)) != std::string::npos) {
+            if (s[i - 1] != '\\')
+                break;
+            ++i;
+        }
+        if (i == std::string::npos)
+            return -3;
+        ++i; // whitespace inside the quotes is part of the value
+    }
+
+    const std::size_t value_end = s.find_first_of(" \n", value_begin);
+    std::size_t value_whitespace_begin = s.find_first_of(" \n", value_end);
+    if (value_whitespace_begin < i)
+        value_whitespace_begin = i;
+
+    if (value_whitespace_begin == std::string::npos)
+        return 0;
+
+    std::size_t trailing_nonwhitespace_begin =
+        s.find_first_not_of(" \n", value_whitespace_begin);
+    if (trailing_nonwhitespace_begin != std::string::npos)
+        return -3;
+
+    if (s.find('\n') < value_whitespace_begin)
+        return -4;
+
+    // else all tests pass, return success
+    return 0;
+}
+
+NO_DISCARD constexpr bool LINE_IS_WHITESPACE(std::string_view s) noexcept {
+    return s.find_first_not_of(" \n") == std::string::npos;
+}
+
+// header lines begin with '[', so values containing brackets are not 
+// mistaken for headers
+NO_DISCARD constexpr bool 
+LINE_CONTAINS_SECTION_HEADER(std::string_view s) noexcept {
+    const std::size_t open = s.find_first_not_of(" \n");
+    return open != std::string::npos && s[open] == '[' &&
+           s.find(']', open) != std::string::npos;
+}
+
+// outcome of parsing a single line. values are returned rather than thrown
+// so that invalid lines cost no more than valid ones.
+enum class PARSE_ERROR : int8_t {
+    NONE                =  0,
+    NOT_A_KV            = -1,
+    INVALID_WHITESPACE  = -2,
+    INVALID_VALUE       = -3,
+    OUT_OF_RANGE        = -4,
+    INVALID_HEADER      = -5
+};
+
+NO_DISCARD constexpr bool ERROR(PARSE_ERROR e) noexcept {
+    return e != PARSE_ERROR::NONE;
+}
+
+inline static const std::map<PARSE_ERROR, std::string_view> 
+PARSE_ERROR_STR = 
+{
+    { PARSE_ERROR::NONE,               "no error"                    },
+    { PARSE_ERROR::NOT_A_KV,           "expected key = value"        },
+    { PARSE_ERROR::INVALID_WHITESPACE, "unexpected whitespace"       },
+    { PARSE_ERROR::INVALID_VALUE,      "invalid value"               },
+    { PARSE_ERROR::OUT_OF_RANGE,       "value out of range"          },
+    { PARSE_ERROR::INVALID_HEADER,     "invalid section header"      }
+};
+
+// a line that could not be parsed: where it is, 1-based, and the byte 
+// range of its content (comment excluded) within the buffer parsed
+struct diagnostic {
+    std::uint64_t offset = 0;
+    std::uint32_t size = 0;
+    std::uint32_t line = 0;
+    std::uint32_t column = 0;
+    PARSE_ERROR code = PARSE_ERROR::NONE;
+};
+
+// what a parse does once a line turns out to be invalid
+enum class DIAGNOSTICS_POLICY : int8_t {
+    SKIP        = 0,  // record it and carry on
+    STOP_FIRST  = 1,  // stop at the first invalid line
+    STOP_AFTER  = 2   // stop at the limit-th invalid line; limit >= 1
+};
+
+// collects the diagnostics of a parse into a buffer allocated up front.
+// recording one never allocates or throws; once the buffer is full, 
+// further diagnostics are only counted. messages are only formatted when
+// asked for.
+class diagnostics {
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY = 256;
+
+    // limit is only read with STOP_AFTER. a limit of 0 would stop before
+    // the first invalid line, which cannot be done, so it throws 
+    // std::invalid_argument rather than quietly meaning the same as 1.
+    explicit diagnostics(DIAGNOSTICS_POLICY policy = DIAGNOSTICS_POLICY::SKIP,
+                         std::size_t limit = 0,
+                         std::size_t capacity = DEFAULT_CAPACITY)
+        : policy_(policy),
+          limit_(policy == DIAGNOSTICS_POLICY::STOP_FIRST ? 1 : limit)
+    {
+        if (policy == DIAGNOSTICS_POLICY::STOP_AFTER && limit == 0)
+            throw std::invalid_argument("STOP_AFTER needs a limit above 0.");
+        records_.reserve(capacity);
+    }
+
+    // records d if there is room. returns false if the parse should stop.
+    bool report(const diagnostic& d) noexcept {
+        ++count_;
+        if (records_.size() < records_.capacity())
+            records_.push_back(d);
+        if (policy_ != DIAGNOSTICS_POLICY::SKIP && count_ >= limit_)
+            stopped_ = true;
+        return !stopped_;
+    }
+
+    NO_DISCARD std::span<const diagnostic> records() const noexcept {
+        return records_;
+    }
+
+    // every diagnostic reported, including those there was no room for
+    NO_DISCARD std::size_t count() const noexcept { return count_; }
+    NO_DISCARD std::size_t dropped() const noexcept { 
+        return count_ - records_.size(); 
+    }
+    // true if the policy stopped the parse
+    NO_DISCARD bool stopped() const noexcept { return stopped_; }
+
+    // forgets everything reported, keeping the buffer
+    void clear() noexcept {
+        records_.clear();
+        count_ = 0;
+        stopped_ = false;
+    }
+
+    // "line:column: reason: content", with the content taken from text,
+    // the buffer that was parsed
+    NO_DISCARD static std::string 
+    message(const diagnostic& d, std::string_view text) {
+        const std::string_view content = d.offset <= text.size() ? 
+            text.substr(d.offset, d.size) : 
+            std::string_view{};
+        const auto it = PARSE_ERROR_STR.find(d.code);
+        return util::format("{}:{}: {}: {}", 
+                            d.line, 
+                            d.column, 
+                            it == PARSE_ERROR_STR.end() ? "unknown error" : 
+                                                          it->second,
+                            content);
+    }
+
+private:
+    DIAGNOSTICS_POLICY policy_;
+    std::size_t limit_;
+    std::size_t count_ = 0;
+    bool stopped_ = false;
+    std::vector<diagnostic> records_;
+};
+
+// result of classifying a raw value token. digits is the part of the token
+// the converter reads: a number without its sign, prefix or postfix, the 
+// contents of a quoted string, or the token itself.
+struct value_class {
+    KV_PAIR_VALUE type = KV_PAIR_VALUE::ERR;
+    int base = 10;
+    bool negative = false;
+    std::string_view digits;
+};
+
+NO_DISCARD constexpr bool CHAR_IS_DIGIT(char c, int base) noexcept {
+    if (c >= '0' && c <= '9')
+        return c - '0' < base;
+    c = static_cast<char>(c | 0x20);
+    return base == 16 && c >= 'a' && c <= 'f';
+}
+
+// compares s against an all-lowercase literal, ignoring the case of s
+NO_DISCARD constexpr bool 
+STRING_EQUALS_IGNORE_CASE(std::string_view s, std::string_view lower) noexcept {
+    if (s.size() != lower.size())
+        return false;
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        if (static_cast<char>(s[i] | 0x20) != lower[i])
+            return false;
+    }
+    return true;
+}
+
+// works out the type of a trimmed value token in a single pass, without
+// converting it. integers may carry a sign and be written as 0x1f / 1fh
+// (hex), 017 / 0o17 / 17o (octal) or decimal; anything with a decimal point
+// or exponent is a float, including hex floats such as 0x1.8p3
+// (1.5 * 2^3). a quoted string must be closed by an unescaped double-quote
+// at the end of the token, and any other token is a bare-word string.
+NO_DISCARD constexpr value_class classify_value(std::string_view s) noexcept {
+    value_class c;
+    if (s.empty())
+        return c;
+
+    if (s.front() == '"') {
+        for (std::size_t i = 1; i < s.size(); ++i) {
+            if (s[i] != '"' || s[i - 1] == '\\')
+                continue;
+            if (i + 1 == s.size()) {
+                c.type = KV_PAIR_VALUE::STRING;
+                c.digits = s.substr(1, i - 1);
+            }
+            return c;
+        }
+        return c; // no closing quote
+    }
+
+    if (STRING_EQUALS_IGNORE_CASE(s, "true") || 
+        STRING_EQUALS_IGNORE_CASE(s, "false")) {
+        c.type = KV_PAIR_VALUE::BOOL;
+        c.digits = s;
+        return c;
+    }
+
+    // anything that fails to scan as a number below is a bare-word string
+    value_class str;
+    str.type = KV_PAIR_VALUE::STRING;
+    str.digits = s;
+
+    std::string_view n = s;
+    if (n.front() == '+' || n.front() == '-') {
+        c.negative = n.front() == '-';
+        n.remove_prefix(1);
+    }
+    if (n.empty())
+        return str;
+
+    // prefixed and postfixed forms must start with a digit, so words like
+    // "beach" stay strings
+    const bool leading_digit = CHAR_IS_DIGIT(n.front(), 10);
+    const char last = static_cast<char>(n.back() | 0x20);
+    bool hex_prefix = false;
+    if (leading_digit && n.size() > 2 && n[0] == '0' && (n[1] | 0x20) == 'x') {
+        c.base = 16;
+        n.remove_prefix(2);
+        hex_prefix = true;
+    } else if (leading_digit && n.size() > 2 && 
+               n[0] == '0' && (n[1] | 0x20) == 'o') {
+        c.base = 8;
+        n.remove_prefix(2);
+    } else if (leading_digit && n.size() > 1 && last == 'h') {
+        c.base = 16;
+        n.remove_suffix(1);
+    } else if (leading_digit && n.size() > 1 && last == 'o') {
+        c.base = 8;
+        n.remove_suffix(1);
+    }
+
+    if (c.base != 10) {
+        // hex digits [. hex digits] [p [sign] decimal digits], a float if
+        // it has a point or exponent; only the 0x form may be a float
+        std::size_t i = 0;
+        std::size_t mantissa_digits = 0;
+        bool is_float = false;
+        for (; i < n.size() && CHAR_IS_DIGIT(n[i], c.base); ++i)
+            ++mantissa_digits;
+        if (hex_prefix && i < n.size() && n[i] == '.') {
+            is_float = true;
+            for (++i; i < n.size() && CHAR_IS_DIGIT(n[i], 16); ++i)
+                ++mantissa_digits;
+        }
+        if (hex_prefix && mantissa_digits > 0 && 
+            i < n.size() && (n[i] | 0x20) == 'p') {
+            is_float = true;
+            if (++i < n.size() && (n[i] == '+' || n[i] == '-'))
+                ++i;
+            const std::size_t exp_begin = i;
+            while (i < n.size() && CHAR_IS_DIGIT(n[i], 10))
+                ++i;
+            if (i == exp_begin)
+                return str;
+        }
+        if (mantissa_digits == 0 || i != n.size())
+            return str;
+
+        c.digits = n;
+        if (is_float)
+            c.type = KV_PAIR_VALUE::FLOAT;
+        else
+            c.type = c.negative ? KV_PAIR_VALUE::INT : KV_PAIR_VALUE::UINT;
+        return c;
+    }
+
+    // decimal: digits [. digits] [e [sign] digits], with at least one 
+    // mantissa digit and, if an exponent is present, one exponent digit
+    std::size_t i = 0;
+    std::size_t mantissa_digits = 0;
+    bool octal_digits_only = true;
+    for (; i < n.size() && CHAR_IS_DIGIT(n[i], 10); ++i, ++mantissa_digits)
+        octal_digits_only = octal_digits_only && n[i] < '8';
+
+    bool is_float = false;
+    if (i < n.size() && n[i] == '.') {
+        is_float = true;
+        for (++i; i < n.size() && CHAR_IS_DIGIT(n[i], 10); ++i)
+            ++mantissa_digits;
+    }
+    if (mantissa_digits == 0)
+        return str;
+
+    if (i < n.size() && (n[i] | 0x20) == 'e') {
+        is_float = true;
+        if (++i < n.size() && (n[i] == '+' || n[i] == '-'))
+            ++i;
+        const std::size_t exp_begin = i;
+        while (i < n.size() && CHAR_IS_DIGIT(n[i], 10))
+            ++i;
+        if (i == exp_begin)
+            return str;
+    }
+    if (i != n.size())
+        return str;
+
+    c.digits = n;
+    if (is_float) {
+        c.type = KV_PAIR_VALUE::FLOAT;
+        return c;
+    }
+
+    // a leading zero marks an octal integer, as with strtoull's base 0
+    if (n.size() > 1 && n.front() == '0') {
+        if (!octal_digits_only)
+            return str;
+        c.base = 8;
+        c.digits = n.substr(1);
+    }
+    c.type = c.negative ? KV_PAIR_VALUE::INT : KV_PAIR_VALUE::UINT;
+    return c;
+}
+
+NO_DISCARD constexpr bool parse_kv_value_as_bool(const value_class& c) noexcept {
+    return (c.digits.front() | 0x20) == 't';
+}
+
+// from_chars is not usable in constant evaluation, so the conversions 
+// below fall back on these there. integers convert exactly. floats only 
+// convert where a single correctly rounded operation gives the result that
+// from_chars would: a decimal mantissa exact in float_type scaled by an 
+// exact power of ten, or a hex mantissa that fits, scaled by a power of two
+// into the normal range. anything else is INVALID_VALUE rather than risk a
+// compile-time value differing from the run-time one.
+namespace constant {
+
+NO_DISCARD constexpr int DIGIT_VALUE(char c) noexcept {
+    return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10;
+}
+
+NO_DISCARD constexpr PARSE_ERROR
+parse_uint(std::string_view digits, int base, std::uintmax_t& out) noexcept {
+    if (digits.empty())
+        return PARSE_ERROR::INVALID_VALUE;
+    constexpr std::uintmax_t max = std::numeric_limits<std::uintmax_t>::max();
+    const auto b = static_cast<std::uintmax_t>(base);
+    std::uintmax_t n = 0;
+    for (const char ch : digits) {
+        if (!CHAR_IS_DIGIT(ch, base))
+            return PARSE_ERROR::INVALID_VALUE;
+        const auto d = static_cast<std::uintmax_t>(DIGIT_VALUE(ch));
+        if (n > (max - d) / b)
+            return PARSE_ERROR::OUT_OF_RANGE;
+        n = n * b + d;
+    }
+    out = n;
+    return PARSE_ERROR::NONE;
+}
+
+// x * base^exp with a single rounding, given that base^|exp| is exact
+template<typename F>
+NO_DISCARD constexpr F scale(F x, int base, int exp) noexcept {
+    F p = 1;
+    for (int i = exp < 0 ? -exp : exp; i > 0; --i)
+        p *= static_cast<F>(base);
+    return exp < 0 ? x / p : x * p;
+}
+
+NO_DISCARD constexpr PARSE_ERROR
+parse_float(std::string_view n, bool hex, kv::float_type& out) noexcept {
+    using F = kv::float_type;
+    constexpr int BITS = std::numeric_limits<F>::digits;
+    // the largest mantissa held exactly
+    constexpr std::uint64_t EXACT = BITS >= 64 ? ~0ULL : (1ULL << BITS) - 1;
+    const int base = hex ? 16 : 10;
+
+    // the value is m * base^exp * 2^bin_exp
+    std::uint64_t m = 0;
+    int exp = 0;
+    int bin_exp = 0;
+    bool point = false;
+    std::size_t i = 0;
+    for (; i < n.size(); ++i) {
+        if (n[i] == '.') {
+            point = true;
+            continue;
+        }
+        if (!CHAR_IS_DIGIT(n[i], base))
+            break;
+        const auto d = static_cast<std::uint64_t>(DIGIT_VALUE(n[i]));
+        if (m > (~0ULL - d) / static_cast<std::uint64_t>(base)) {
+            // digits past what fits only matter if they are not zeros
+            if (d != 0)
+                return PARSE_ERROR::INVALID_VALUE;
+            if (!point)
+                ++exp;
+            continue;
+        }
+        m = m * static_cast<std::uint64_t>(base) + d;
+        if (point)
+            --exp;
+    }
+    if (i < n.size()) {
+        // the classifier has checked the exponent's form. it is decimal,
+        // of a power of two for hex floats; huge ones saturate, as they 
+        // are out of range for any nonzero mantissa
+        const bool negative = n[++i] == '-';
+        if (n[i] == '+' || n[i] == '-')
+            ++i;
+        int e = 0;
+        for (; i < n.size(); ++i)
+            e = std::min(e * 10 + (n[i] - '0'), 100000);
+        (hex ? bin_exp : exp) += negative ? -e : e;
+    }
+    if (m == 0) {
+        out = 0;
+        return PARSE_ERROR::NONE;
+    }
+
+    if (hex) {
+        // each hex digit is four bits
+        exp = exp * 4 + bin_exp;
+        while (m > EXACT && (m & 1) == 0) {
+            m >>= 1;
+            ++exp;
+        }
+        if (m > EXACT)
+            return PARSE_ERROR::INVALID_VALUE;
+        const int top = exp + static_cast<int>(std::bit_width(m)) - 1;
+        if (top >= std::numeric_limits<F>::max_exponent)
+            return PARSE_ERROR::OUT_OF_RANGE;
+        if (top < std::numeric_limits<F>::min_exponent - 1)
+            return PARSE_ERROR::INVALID_VALUE;
+        // halving or doubling a normal float is exact, so the steps can
+        // be taken one at a time without overflowing a power of two
+        out = static_cast<F>(m);
+        for (; exp > 0; --exp)
+            out *= 2;
+        for (; exp < 0; ++exp)
+            out /= 2;
+        return PARSE_ERROR::NONE;
+    }
+
+    // the largest power of ten that is exact: 5^k must fit in the mantissa
+    int exact_pow = 0;
+    for (std::uint64_t p = 1; p <= EXACT / 5; p *= 5)
+        ++exact_pow;
+    while (m % 10 == 0) {
+        m /= 10;
+        ++exp;
+    }
+    while (exp > exact_pow && m <= EXACT / 10) {
+        m *= 10;
+        --exp;
+    }
+    if (m > EXACT || exp > exact_pow || exp < -exact_pow)
+        return PARSE_ERROR::INVALID_VALUE;
+    out = scale(static_cast<F>(m), 10, exp);
+    return PARSE_ERROR::NONE;
+}
+
+} // namespace constant
+
+NO_DISCARD constexpr PARSE_ERROR 
+parse_kv_value_as_unsigned_int(const value_class& c, std::size_t& out) noexcept {
+    if (std::is_constant_evaluated()) {
+        std::uintmax_t n = 0;
+        const PARSE_ERROR e = constant::parse_uint(c.digits, c.base, n);
+        if (!ERROR(e) && !std::in_range<std::size_t>(n))
+            return PARSE_ERROR::OUT_OF_RANGE;
+        out = static_cast<std::size_t>(n);
+        return e;
+    }
+    const char* end = c.digits.data() + c.digits.size();
+    const auto [p, ec] = std::from_chars(c.digits.data(), end, out, c.base);
+    if (ec == std::errc::result_out_of_range)
+        return PARSE_ERROR::OUT_OF_RANGE;
+    if (ec != std::errc() || p != end)
+        return PARSE_ERROR::INVALID_VALUE;
+    return PARSE_ERROR::NONE;
+}
+
+NO_DISCARD constexpr PARSE_ERROR 
+parse_kv_value_as_signed_int(const value_class& c, std::intmax_t& out) noexcept {
+    // convert the magnitude so the sign and prefix can stay separate
+    std::uintmax_t magnitude = 0;
+    if (std::is_constant_evaluated()) {
+        const PARSE_ERROR e = constant::parse_uint(c.digits, c.base, magnitude);
+        if (ERROR(e))
+            return e;
+    } else {
+        const char* end = c.digits.data() + c.digits.size();
+        const auto [p, ec] = 
+            std::from_chars(c.digits.data(), end, magnitude, c.base);
+        if (ec == std::errc::result_out_of_range)
+            return PARSE_ERROR::OUT_OF_RANGE;
+        if (ec != std::errc() || p != end)
+            return PARSE_ERROR::INVALID_VALUE;
+    }
+
+    constexpr auto max = 
+        static_cast<std::uintmax_t>(std::numeric_limits<std::intmax_t>::max());
+    if (magnitude > max + (c.negative ? 1 : 0))
+        return PARSE_ERROR::OUT_OF_RANGE;
+
+    out = c.negative ? 
+        static_cast<std::intmax_t>(0 - magnitude) : 
+        static_cast<std::intmax_t>(magnitude);
+    return PARSE_ERROR::NONE;
+}
+
+// from_chars rounds correctly, in either base
+NO_DISCARD constexpr PARSE_ERROR 
+parse_kv_value_as_float(const value_class& c, kv::float_type& out) noexcept {
+    if (std::is_constant_evaluated()) {
+        const PARSE_ERROR e = constant::parse_float(c.digits, c.base == 16, out);
+        if (!ERROR(e) && c.negative)
+            out = -out;
+        return e;
+    }
+    const char* end = c.digits.data() + c.digits.size();
+    const auto [p, ec] = std::from_chars(
+        c.digits.data(), 
+        end, 
+        out, 
+        c.base == 16 ? std::chars_format::hex : std::chars_format::general);
+    if (ec == std::errc::result_out_of_range)
+        return PARSE_ERROR::OUT_OF_RANGE;
+    if (ec != std::errc() || p != end)
+        return PARSE_ERROR::INVALID_VALUE;
+    if (c.negative)
+        out = -out;
+    return PARSE_ERROR::NONE;
+}
+
+// strings need no conversion; the classifier has already found the quotes
+NO_DISCARD constexpr std::string_view 
+parse_kv_value_as_string(const value_class& c) noexcept {
+    return c.digits;
+}
+
+// splits a kv line into its key and raw value tokens
+NO_DISCARD constexpr PARSE_ERROR 
+tokenize_kv(std::string_view s, 
+            std::string_view& key, 
+            std::string_view& value) noexcept {
+    if (ERROR(LINE_CONTAINS_KV(s)))
+        return PARSE_ERROR::NOT_A_KV;
+
+    if (ERROR(KV_STRING_CONTAINS_INVALID_WHITESPACE(s)))
+        return PARSE_ERROR::INVALID_WHITESPACE;
+
+    const std::size_t delim_pos = s.find('=');
+    const std::size_t key_begin = s.find_first_not_of(' ');
+    std::size_t key_end = s.find(' ', key_begin);
+    if (key_end > delim_pos)
+        key_end = delim_pos;
+    key = s.substr(key_begin, key_end - key_begin);
+
+    const std::size_t value_begin = s.find_first_not_of(" \n", delim_pos + 1);
+    // if value is not multi-word string
+    if (s[value_begin] == '"') {
+        std::size_t i = value_begin;
+        while ((i = s.find('"', i + 1)) != std::string::npos) {
+            if (s[i - 1] != '\\')
+                break;
+        }
+        value = s.substr(value_begin, i - value_begin + 1);
+    } else {
+        const std::size_t value_whitespace_begin =
+            s.find_first_of(" \n", value_begin);
+        value = s.substr(value_begin, value_whitespace_begin - value_begin);
+    }
+    return PARSE_ERROR::NONE;
+}
+
+// converts a classified value token into v. strings too long to be stored
+// inline are stored as their offset within text, which must contain them.
+NO_DISCARD inline PARSE_ERROR 
+parse_kv_value(const value_class& c, 
+               std::string_view text, 
+               kv::value& v) noexcept {
+    PARSE_ERROR e = PARSE_ERROR::NONE;
+    switch (c.type) {
+    case KV_PAIR_VALUE::BOOL:
+        v = parse_kv_value_as_bool(c);
+        break;
+    case KV_PAIR_VALUE::UINT: {
+        std::size_t i = 0;
+        if (!ERROR(e = parse_kv_value_as_unsigned_int(c, i)))
+            v = i;
+        break;
+    }
+    case KV_PAIR_VALUE::INT: {
+        std::intmax_t i = 0;
+        if (!ERROR(e = parse_kv_value_as_signed_int(c, i)))
+            v = i;
+        break;
+    }
+    case KV_PAIR_VALUE::FLOAT: {
+        kv::float_type f = 0;
+        if (!ERROR(e = parse_kv_value_as_float(c, f)))
+            v = f;
+        break;
+    }
+    case KV_PAIR_VALUE::STRING:
+        if (!v.set_string(parse_kv_value_as_string(c), text))
+            e = PARSE_ERROR::OUT_OF_RANGE;
+        break;
+    default:
+        e = PARSE_ERROR::INVALID_VALUE;
+        break;
+    }
+    return e;
+}
+
+// converts an array token, comma-separated elements between brackets, 
+// into v, appending its elements to arrays. elements are written as values
+// are, but cannot themselves be arrays. the array is packed if its 
+// elements are all UINT, all INT or UINT within the range of 
+// std::intmax_t, or all FLOAT. strings too long to be stored inline are 
+// stored as their offset within text.
+NO_DISCARD inline PARSE_ERROR
+parse_kv_array(std::string_view raw,
+               std::string_view text,
+               kv::array_pool& arrays,
+               kv::value& v) {
+    if (raw.size() < 2 || raw.front() != '[' || raw.back() != ']')
+        return PARSE_ERROR::INVALID_VALUE;
+
+    auto trim = [](std::string_view e) {
+        while (!e.empty() && CHAR_IS_WHITESPACE(e.front()))
+            e.remove_prefix(1);
+        while (!e.empty() && CHAR_IS_WHITESPACE(e.back()))
+            e.remove_suffix(1);
+        return e;
+    };
+    const std::string_view inner = raw.substr(1, raw.size() - 2);
+
+    // elements are converted into the value pool, then moved to a packed
+    // pool if they turn out to share a type
+    auto& values = arrays.elements;
+    const std::size_t first = values.size();
+    auto fail = [&](PARSE_ERROR e) {
+        values.resize(first);
+        return e;
+    };
+
+    if (!trim(inner).empty()) {
+        bool in_quote = false;
+        std::size_t begin = 0;
+        for (std::size_t i = 0; i <= inner.size(); ++i) {
+            if (i < inner.size()) {
+                if (inner[i] == '"' && (i == 0 || inner[i - 1] != '\\'))
+                    in_quote = !in_quote;
+                if (inner[i] != ',' || in_quote)
+                    continue;
+            }
+
+            const std::string_view e = trim(inner.substr(begin, i - begin));
+            begin = i + 1;
+            if (e.empty() || e.front() == '[')
+                return fail(PARSE_ERROR::INVALID_VALUE);
+
+            kv::value x;
+            if (const PARSE_ERROR pe = parse_kv_value(classify_value(e), text, x); 
+                ERROR(pe))
+                return fail(pe);
+            values.push_back(x);
+        }
+    }
+
+    const std::span<const kv::value> es(values.data() + first, 
+                                        values.size() - first);
+    const kv::storage st = arrays.storage_of(text);
+    bool uints = !es.empty();
+    bool ints = !es.empty();
+    bool floats = !es.empty();
+    for (const auto& x : es) {
+        uints = uints && x.type == KV_PAIR_VALUE::UINT;
+        ints = ints && kv::value_as<std::intmax_t>(x, st).has_value();
+        floats = floats && x.type == KV_PAIR_VALUE::FLOAT;
+    }
+
+    auto pack = [&](auto& pool, KV_PAIR_VALUE t, auto&& get) {
+        const std::size_t at = pool.size();
+        for (const auto& x : es)
+            pool.push_back(get(x));
+        values.resize(first);
+        return v.set_array(at, pool.size() - at, t) ? 
+            PARSE_ERROR::NONE : 
+            PARSE_ERROR::OUT_OF_RANGE;
+    };
+    if (uints) {
+        return pack(arrays.uints, KV_PAIR_VALUE::UINT, [&](const kv::value& x) {
+            return *x.as_uint(st);
+        });
+    }
+    if (ints) {
+        return pack(arrays.ints, KV_PAIR_VALUE::INT, [&](const kv::value& x) {
+            return *kv::value_as<std::intmax_t>(x, st);
+        });
+    }
+    if (floats) {
+        return pack(arrays.floats, KV_PAIR_VALUE::FLOAT, [&](const kv::value& x) {
+            return *x.as_float(st);
+        });
+    }
+    if (!v.set_array(first, es.size()))
+        return fail(PARSE_ERROR::OUT_OF_RANGE);
+    return PARSE_ERROR::NONE;
+}
+
+// strings are read from the raw token whenever they are accessed, so the
+// copy made here is not kept
+NO_DISCARD inline bool 
+kv::decode_lazy(std::string_view raw, value& v) noexcept {
+    return !ERROR(parse_kv_value(classify_value(raw), raw, v));
+}
+
+// long string values are stored relative to s
+NO_DISCARD inline PARSE_ERROR 
+parse_kv(std::string_view s, kv::pair& kv) noexcept {
+    std::string_view v;
+    if (const PARSE_ERROR e = tokenize_kv(s, kv.key, v); ERROR(e))
+        return e;
+
+    return parse_kv_value(classify_value(v), s, kv.val);
+}
+
+// splits a line found by the line scanner into its key and raw value 
+// tokens, using the positions recorded by the scanner instead of searching
+// the line again
+NO_DISCARD constexpr PARSE_ERROR 
+tokenize_kv(const line_scanner& sc, 
+            const line_tokens& t,
+            std::string_view& key, 
+            std::string_view& value) noexcept {
+    if (t.eq == bits::npos)
+        return PARSE_ERROR::NOT_A_KV;
+
+    const std::size_t key_last = sc.last_non_whitespace(t.begin, t.eq);
+    if (key_last == bits::npos)
+        return PARSE_ERROR::NOT_A_KV;
+
+    if (sc.first_whitespace(t.begin, key_last) != bits::npos)
+        return PARSE_ERROR::INVALID_WHITESPACE;
+
+    const std::size_t value_begin = sc.first_non_whitespace(t.eq + 1, t.end);
+    if (value_begin == bits::npos)
+        return PARSE_ERROR::INVALID_VALUE;
+
+    const std::string_view buf = sc.buffer();
+    std::size_t value_end = t.end;
+    if (value_begin == t.quote_open) {
+        if (t.quote_close == bits::npos)
+            return PARSE_ERROR::INVALID_VALUE;
+        value_end = t.quote_close + 1;
+    } else if (buf[value_begin] == '[') {
+        // an array runs to the end of the line, whitespace and all
+    } else if (const std::size_t ws = sc.first_whitespace(value_begin, t.end);
+               ws != bits::npos) {
+        value_end = ws;
+    }
+
+    // anything but whitespace after the value is an error
+    if (value_end != t.end)
+        return PARSE_ERROR::INVALID_WHITESPACE;
+
+    key = buf.substr(t.begin, key_last + 1 - t.begin);
+    value = buf.substr(value_begin, value_end - value_begin);
+    return PARSE_ERROR::NONE;
+}
+
+// long string values are stored relative to the scanner's buffer, and the
+// elements of arrays appended to arrays. a lazy value is only tokenized 
+// here; see kv::value::set_lazy().
+NO_DISCARD inline PARSE_ERROR 
+parse_kv(const line_scanner& sc, 
+         const line_tokens& t, 
+         kv::pair& kv, 
+         kv::array_pool& arrays,
+         bool lazy = false) {
+    std::string_view v;
+    if (const PARSE_ERROR e = tokenize_kv(sc, t, kv.key, v); ERROR(e))
+        return e;
+    if (v.front() == '[')
+        return parse_kv_array(v, sc.buffer(), arrays, kv.val);
+    if (lazy && kv.val.set_lazy(v, sc.buffer()))
+        return PARSE_ERROR::NONE;
+
+    // the scanner has already matched the quotes of a quoted value
+    value_class c;
+    if (v.front() == '"') {
+        c.type = KV_PAIR_VALUE::STRING;
+        c.digits = v.substr(1, v.size() - 2);
+    } else {
+        c = classify_value(v);
+    }
+    return parse_kv_value(c, sc.buffer(), kv.val);
+}
+
+// validates a section header line and extracts the dotted path between its
+// brackets. path components must be non-empty and contain no whitespace.
+NO_DISCARD constexpr PARSE_ERROR 
+parse_section_header(std::string_view s, std::string_view& path) noexcept {
+    if (LINE_IS_WHITESPACE(s))
+        return PARSE_ERROR::INVALID_HEADER;
+
+    s = util::parse::remove_leading_and_trailing_whitespace(s);
+    if (s.size() < 2 || s.front() != '[' || s.back() != ']')
+        return PARSE_ERROR::INVALID_HEADER;
+
+    s = s.substr(1, s.size() - 2);
+    if (LINE_IS_WHITESPACE(s))
+        return PARSE_ERROR::INVALID_HEADER;
+
+    s = util::parse::remove_leading_and_trailing_whitespace(s);
+    bool component_empty = true;
+    for (const auto c : s) {
+        if (c == '.') {
+            if (component_empty)
+                return PARSE_ERROR::INVALID_HEADER;
+            component_empty = true;
+        } else if (c == ' ' || c == '\n' || c == '[' || c == ']' || 
+                   c == '"' || c == '=') {
+            return PARSE_ERROR::INVALID_HEADER;
+        } else {
+            component_empty = false;
+        }
+    }
+    if (component_empty)
+        return PARSE_ERROR::INVALID_HEADER;
+
+    path = s;
+    return PARSE_ERROR::NONE;
+}
+
+// a file whose text starts at offset begin of a document's text
+struct source_file {
+    std::string path;
+    std::size_t begin = 0;
+};
+
+// a parsed file. names and keys are views into text, and string values too
+// long to be stored inline are offsets into it; text is normally buffer, so
+// they remain valid for as long as the document does. everything else the
+// document holds is allocated from a monotonic arena drawing on the given
+// upstream resource, so destroying a document releases a few large blocks
+// rather than one allocation per section or kv.
+struct document {
+    explicit document(
+        std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : generation(next_generation()),
+          arena(std::make_unique<std::pmr::monotonic_buffer_resource>(upstream)),
+          sections(arena.get()),
+          kvs(arena.get()),
+          arrays(arena.get()),
+          section_index(arena.get()),
+          kv_index(arena.get()),
+          key_index(arena.get())
+    {
+
+    }
+
+    // containers moved out keep allocating from the arena they came with
+    document(document&&) noexcept = default;
+
+    // the containers' allocators do not propagate on assignment, so the 
+    // target is rebuilt from o rather than assigned member by member
+    document& operator=(document&& o) noexcept {
+        if (this != &o) {
+            std::destroy_at(this);
+            std::construct_at(this, std::move(o));
+        }
+        return *this;
+    }
+
+    // identifies this version of the document's contents: each document,
+    // and each build into one, gets a number no other has had, so that
+    // what is remembered about one version is not applied to another
+    std::uint64_t generation;
+    file_buffer buffer;
+    std::string_view text;  // what was parsed; a view of buffer if it is set
+    // the arena's upstream, if the document owns it; declared before the 
+    // arena so that it outlives it
+    std::unique_ptr<std::pmr::memory_resource> owned_upstream;
+    // declared before the containers so that it outlives them
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+    std::pmr::vector<section> sections;  // sections[0] is the global section
+    std::pmr::vector<kv::pair> kvs;      // grouped by section, in file order
+    kv::array_pool arrays;               // elements of ARRAY values
+    // interns the keys; shared by every document parsed with the same 
+    // parse_options::symbols
+    std::shared_ptr<symbol_table> symbols;
+    // the files text was assembled from, by where they begin in it; empty
+    // unless the document was put together from includes
+    std::vector<source_file> sources;
+
+    NO_DISCARD const section& global() const noexcept { return sections[0]; }
+
+    NO_DISCARD kv::storage storage() const noexcept {
+        return arrays.storage_of(text);
+    }
+
+    NO_DISCARD kv::value_ref value_of(const kv::pair& p) const noexcept {
+        return { &p.val, storage() };
+    }
+
+    // the path of the file p was read from, or "" if the document was not 
+    // assembled from files
+    NO_DISCARD std::string_view source_of(const kv::pair& p) const noexcept {
+        const auto at = static_cast<std::size_t>(p.key.data() - text.data());
+        if (p.key.data() < text.data() || at >= text.size())
+            return {};
+        const auto it = std::upper_bound(
+            sources.begin(), sources.end(), at,
+            [](std::size_t x, const source_file& f) { return x < f.begin; });
+        return it == sources.begin() ? std::string_view{} : 
+                                       std::string_view((it - 1)->path);
+    }
+
+    // the kvs of section id, or none if there is no such section, as with
+    // an id from another version of the document
+    NO_DISCARD std::span<const kv::pair> kvs_of(section_id id) const noexcept {
+        if (id >= sections.size())
+            return {};
+        const section& s = sections[id];
+        return { kvs.data() + s.first_kv, s.kv_count };
+    }
+
+    // returns the id of the section with the given dotted path ("" for the
+    // global section), or NO_INDEX
+    NO_DISCARD section_id find_section(std::string_view path) const noexcept {
+        return section_index.find(util::hash_bytes(path), [&](auto i) {
+            return sections[i].path == path;
+        });
+    }
+
+    // returns the kv with key sym in section id, or nullptr, also if there
+    // is no such section. if a key appears more than once in a section, the
+    // last one wins. resolving a key to its symbol once and looking it up 
+    // by symbol avoids hashing and comparing its name on every lookup.
+    NO_DISCARD const kv::pair* 
+    find(section_id id, symbol_id sym) const noexcept {
+        if (id >= sections.size())
+            return nullptr;
+        const std::uint32_t i = kv_index.find(hash_key(id, sym), [&](auto j) {
+            return kvs[j].sym == sym && 
+                   j - sections[id].first_kv < sections[id].kv_count;
+        });
+        return i == hash_index::EMPTY ? nullptr : &kvs[i];
+    }
+
+    // returns the symbol of key, or NO_SYMBOL if no kv of the document has
+    // it. the document's own index is read, not the shared symbol table, so
+    // lookups by name take no lock.
+    NO_DISCARD symbol_id symbol_of(std::string_view key) const noexcept {
+        const std::uint32_t i = key_index.find(util::hash_bytes(key), 
+                                               [&](auto j) {
+            return kvs[j].key == key;
+        });
+        return i == hash_index::EMPTY ? NO_SYMBOL : kvs[i].sym;
+    }
+
+    NO_DISCARD const kv::pair* 
+    find(section_id id, std::string_view key) const noexcept {
+        const symbol_id sym = symbol_of(key);
+        return sym == NO_SYMBOL ? nullptr : find(id, sym);
+    }
+
+    // looks up "section.sub.key", or "key" in the global section
+    NO_DISCARD const kv::pair* find(std::string_view path) const noexcept {
+        const std::size_t dot = path.rfind('.');
+        if (dot == std::string_view::npos)
+            return find(0, path);
+
+        const section_id id = find_section(path.substr(0, dot));
+        return id == NO_INDEX ? nullptr : find(id, path.substr(dot + 1));
+    }
+
+    template<typename T>
+    NO_DISCARD std::expected<T, LOOKUP_ERROR> 
+    get(section_id id, symbol_id sym) const noexcept {
+        const kv::pair* p = find(id, sym);
+        if (p == nullptr)
+            return std::unexpected(id < sections.size() ?
+                                   LOOKUP_ERROR::NO_SUCH_KEY :
+                                   LOOKUP_ERROR::NO_SUCH_SECTION);
+        return kv::value_as<T>(p->val, storage());
+    }
+
+    template<typename T>
+    NO_DISCARD std::expected<T, LOOKUP_ERROR> 
+    get(section_id id, std::string_view key) const noexcept {
+        const kv::pair* p = find(id, key);
+        if (p == nullptr)
+            return std::unexpected(id < sections.size() ?
+                                   LOOKUP_ERROR::NO_SUCH_KEY :
+                                   LOOKUP_ERROR::NO_SUCH_SECTION);
+        return kv::value_as<T>(p->val, storage());
+    }
+
+    // typed lookup of "section.sub.key", or "key" in the global section
+    template<typename T>
+    NO_DISCARD std::expected<T, LOOKUP_ERROR> 
+    get(std::string_view path) const noexcept {
+        const std::size_t dot = path.rfind('.');
+        if (dot == std::string_view::npos)
+            return get<T>(0, path);
+
+        const section_id id = find_section(path.substr(0, dot));
+        if (id == NO_INDEX)
+            return std::unexpected(LOOKUP_ERROR::NO_SUCH_SECTION);
+        return get<T>(id, path.substr(dot + 1));
+    }
+
+    // (re)builds the lookup tables; called once parsing has finished
+    void build_index() {
+        section_index.reset(sections.size());
+        for (std::uint32_t i = 0; i < sections.size(); ++i) {
+            section_index.insert(util::hash_bytes(sections[i].path), i, 
+                                 [](auto) { return false; });
+        }
+        build_kv_index();
+        build_key_index();
+    }
+
+    // every kv must have its symbol
+    void build_kv_index() {
+        kv_index.reset(kvs.size());
+        for (section_id id = 0; id < sections.size(); ++id) {
+            const section& s = sections[id];
+            const std::uint32_t end = s.first_kv + s.kv_count;
+            for (std::uint32_t i = s.first_kv; i < end; ++i) {
+                kv_index.insert(hash_key(id, kvs[i].sym), i, [&](auto j) {
+                    return kvs[j].sym == kvs[i].sym && 
+                           j - s.first_kv < s.kv_count;
+                });
+            }
+        }
+    }
+
+    // every kv must have its symbol
+    void build_key_index() {
+        key_index.reset(kvs.size());
+        for (std::uint32_t i = 0; i < kvs.size(); ++i) {
+            key_index.insert(util::hash_bytes(kvs[i].key), i, [&](auto j) {
+                return kvs[j].sym == kvs[i].sym;
+            });
+        }
+    }
+
+    hash_index section_index;
+    hash_index kv_index;
+    hash_index key_index;  // key name -> a kv with that key
+
+    NO_DISCARD static std::uint64_t next_generation() noexcept {
+        static std::atomic<std::uint64_t> next = 1;
+        return next.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    NO_DISCARD static std::uint64_t 
+    hash_key(section_id id, symbol_id sym) noexcept {
+        return util::hash_int((static_cast<std::uint64_t>(id) << 32) | sym);
+    }
+};
+
+// appends sections and kvs to a document as they are parsed, keeping each
+// section's kvs contiguous and interning their keys in the document's
+// symbols, which are created if it has none
+class document_builder {
+public:
+    // the builder's own bookkeeping lives in a scratch arena that is 
+    // released in one go when the builder is destroyed
+    explicit document_builder(document& doc) 
+        : doc_(doc),
+          scratch_(doc.arena->upstream_resource()),
+          last_child_(&scratch_),
+          owner_(&scratch_),
+          by_path_(&scratch_),
+          by_key_(&scratch_)
+    {
+        if (!doc_.symbols)
+            doc_.symbols = std::make_shared<symbol_table>();
+        doc_.generation = document::next_generation();
+        doc_.sections.assign(1, section{});
+        doc_.kvs.clear();
+        doc_.arrays.clear();
+        last_child_.assign(1, NO_INDEX);
+    }
+
+    // makes path (creating it and its ancestors if needed) the section that
+    // subsequent kvs belong to; "" is the global section
+    void on_section(std::string_view path) {
+        current_ = open_section(path);
+    }
+
+    // v must refer to the document's text; its array elements, if any, 
+    // are copied into the document
+    void on_kv(std::string_view key, const kv::value_ref& v) {
+        reserve_kvs(1);
+        owner_.push_back(current_);
+        kv::pair& p = doc_.kvs.emplace_back();
+        p.key = key;
+        p.sym = intern(key);
+        p.val = doc_.arrays.adopt(*v.v, v.st);
+    }
+
+    // invalid lines are left out; they are only recorded if the builder
+    // has a sink, whose policy decides whether the parse goes on
+    bool on_error(const diagnostic& d) noexcept {
+        ++errors_;
+        return diagnostics_ == nullptr || diagnostics_->report(d);
+    }
+
+    // the invalid lines seen so far
+    NO_DISCARD std::size_t errors() const noexcept { return errors_; }
+
+    void set_diagnostics(diagnostics* d) noexcept { diagnostics_ = d; }
+
+    // appends a run of kvs to the current section, copying the elements
+    // of their arrays from the pools of from. kvs that already have a 
+    // symbol must have it from the document's symbols.
+    void on_kvs(std::span<const kv::pair> ps, const kv::storage& from = {}) {
+        if (ps.empty())
+            return;
+
+        reserve_kvs(ps.size());
+        owner_.insert(owner_.end(), ps.size(), current_);
+        const std::size_t first = doc_.kvs.size();
+        doc_.kvs.insert(doc_.kvs.end(), ps.begin(), ps.end());
+        for (std::size_t i = first; i < doc_.kvs.size(); ++i) {
+            kv::pair& p = doc_.kvs[i];
+            if (p.sym == NO_SYMBOL)
+                p.sym = intern(p.key);
+            if (p.val.type == KV_PAIR_VALUE::ARRAY)
+                p.val = doc_.arrays.adopt(p.val, from);
+        }
+    }
+
+    void finish() {
+        if (regroup_)
+            regroup();
+        doc_.build_index();
+    }
+
+private:
+    // the table is only consulted, under its lock, for keys new to this
+    // build; most keys repeat across sections
+    symbol_id intern(std::string_view key) {
+        const auto [it, added] = by_key_.try_emplace(key, NO_SYMBOL);
+        if (added)
+            it->second = doc_.symbols->intern(key);
+        return it->second;
+    }
+
+    // accounts for n kvs about to be appended to the current section
+    void reserve_kvs(std::size_t n) {
+        if (doc_.kvs.size() + n >= NO_INDEX)
+            throw std::length_error("too many kvs in document.");
+
+        section& s = doc_.sections[current_];
+        if (s.kv_count == 0)
+            s.first_kv = static_cast<std::uint32_t>(doc_.kvs.size());
+        else if (s.first_kv + s.kv_count != doc_.kvs.size())
+            regroup_ = true; // section was reopened after another one
+
+        s.kv_count += static_cast<std::uint32_t>(n);
+    }
+
+    void regroup() {
+        // counting sort by owning section; stable, so file order is kept
+        // within each section
+        std::uint32_t next = 0;
+        for (auto& s : doc_.sections) {
+            s.first_kv = next;
+            next += s.kv_count;
+        }
+
+        std::pmr::vector<std::uint32_t> fill(doc_.sections.size(), 0, &scratch_);
+        std::pmr::vector<kv::pair> grouped(doc_.kvs.size(), 
+                                           doc_.kvs.get_allocator());
+        for (std::size_t i = 0; i < doc_.kvs.size(); ++i) {
+            const section_id id = owner_[i];
+            grouped[doc_.sections[id].first_kv + fill[id]++] = doc_.kvs[i];
+        }
+        doc_.kvs = std::move(grouped);
+    }
+
+    section_id open_section(std::string_view path) {
+        if (path.empty())
+            return 0;
+        if (const auto it = by_path_.find(path); it != by_path_.end())
+            return it->second;
+
+        if (doc_.sections.size() >= NO_INDEX)
+            throw std::length_error("too many sections in document.");
+
+        const std::size_t dot = path.rfind('.');
+        const section_id parent = dot == std::string_view::npos ? 
+            0 : 
+            open_section(path.substr(0, dot));
+
+        const auto id = static_cast<section_id>(doc_.sections.size());
+        section s;
+        s.name = dot == std::string_view::npos ? path : path.substr(dot + 1);
+        s.path = path;
+        s.parent = parent;
+        doc_.sections.push_back(s);
+
+        if (last_child_[parent] == NO_INDEX)
+            doc_.sections[parent].first_child = id;
+        else
+            doc_.sections[last_child_[parent]].next_sibling = id;
+        last_child_[parent] = id;
+        last_child_.push_back(NO_INDEX);
+
+        by_path_.emplace(path, id);
+        return id;
+    }
+
+    document& doc_;
+    diagnostics* diagnostics_ = nullptr;
+    std::size_t errors_ = 0;
+    section_id current_ = 0;
+    bool regroup_ = false;
+    std::pmr::monotonic_buffer_resource scratch_;
+    std::pmr::vector<section_id> last_child_;
+    std::pmr::vector<section_id> owner_;
+    std::pmr::unordered_map<std::string_view, section_id> by_path_;
+    std::pmr::unordered_map<std::string_view, symbol_id> by_key_;
+};
+
+// receives the events of a streaming parse. on_section() is passed the 
+// dotted path of each header, on_kv() each key and its converted value, and
+// on_error() a diagnostic for each line that could not be parsed. values 
+// refer to the buffer being parsed. the views passed in are only valid for
+// the duration of the call. any of the three may return false to stop the
+// parse early; handlers that never stop may return void.
+template<typename H>
+concept parse_handler = requires(H& h, 
+                                 std::string_view s, 
+                                 const kv::value_ref& v,
+                                 const diagnostic& d) {
+    h.on_section(s);
+    h.on_kv(s, v);
+    h.on_error(d);
+};
+
+// calls f, treating a void result as "continue"
+template<typename F> NO_DISCARD bool HANDLER_CONTINUES(F&& f) {
+    if constexpr (std::is_void_v<std::invoke_result_t<F>>) {
+        f();
+        return true;
+    } else {
+        return static_cast<bool>(f());
+    }
+}
+
+// parses every line the scanner returns, handing headers, kvs and errors to
+// h. returns false if h stopped the parse.
+template<parse_handler H>
+bool parse_lines(line_scanner& sc, H& h, bool lazy = false) {
+    const std::string_view buf = sc.buffer();
+    // holds the elements of the current line's array, if it has one
+    kv::array_pool arrays;
+    line_tokens t;
+
+    while (sc.next(t)) {
+        if (t.begin == t.end)
+            continue;
+
+        auto error = [&](PARSE_ERROR e) {
+            const diagnostic d{
+                t.begin,
+                static_cast<std::uint32_t>(t.end - t.begin),
+                static_cast<std::uint32_t>(t.number),
+                static_cast<std::uint32_t>(t.begin - t.line_begin + 1),
+                e
+            };
+            return HANDLER_CONTINUES([&] { return h.on_error(d); });
+        };
+        if (buf[t.begin] == '[') {
+            std::string_view path;
+            const PARSE_ERROR e = parse_section_header(
+                buf.substr(t.begin, t.end - t.begin), path);
+            const bool go_on = ERROR(e) ?
+                error(e) :
+                HANDLER_CONTINUES([&] { return h.on_section(path); });
+            if (!go_on)
+                return false;
+            continue;
+        }
+
+        kv::pair p;
+        if (!arrays.empty())
+            arrays.clear();
+        const PARSE_ERROR e = parse_kv(sc, t, p, arrays, lazy);
+        const bool go_on = ERROR(e) ?
+            error(e) :
+            HANDLER_CONTINUES([&] { 
+                return h.on_kv(p.key, 
+                               kv::value_ref{ &p.val, arrays.storage_of(buf) }); 
+            });
+        if (!go_on)
+            return false;
+    }
+    return true;
+}
+
+// streams the events of buf to h without building a document, in memory
+// that does not grow with the size of buf. returns false if h stopped the
+// parse early.
+template<parse_handler H>
+bool parse_events(std::string_view buf, H& h) {
+    line_scanner sc(buf);
+    return parse_lines(sc, h);
+}
+
+// as parse_events(), over a memory-mapped file that is unmapped on return
+template<parse_handler H>
+bool parse_file_events(std::string_view path, H& h) {
+    const file_buffer f = load_file(path);
+    return parse_events(f.view(), h);
+}
+
+// what a parse did and what it cost. phases that did not run take no 
+// time: merging only happens in parallel parses, and loading in 
+// parse_file(). allocations are those of the document's arena and the 
+// builder's scratch arena from their upstream, so they are only counted 
+// when the parse creates the document.
+struct parse_stats {
+    std::size_t bytes = 0;
+    std::size_t lines = 0;
+    std::size_t sections = 0;
+    std::size_t kvs = 0;
+    std::size_t errors = 0;
+    // kvs by value type, indexed by value_index()
+    std::array<std::size_t, 8> values{};
+
+    std::chrono::nanoseconds load{};   // reading the file
+    std::chrono::nanoseconds parse{};  // scanning and converting
+    std::chrono::nanoseconds merge{};  // adding the chunks to the document
+    std::chrono::nanoseconds index{};  // building the lookup indexes
+
+    std::size_t allocations = 0;
+    std::size_t allocated_bytes = 0;
+    std::size_t peak_bytes = 0;      // the most held at once while parsing
+    std::size_t document_bytes = 0;  // held by the finished document
+
+    NO_DISCARD static constexpr std::size_t value_index(KV_PAIR_VALUE t) noexcept {
+        return static_cast<std::size_t>(static_cast<int>(t) + 1);
+    }
+
+    NO_DISCARD std::size_t of_type(KV_PAIR_VALUE t) const noexcept {
+        return values[value_index(t)];
+    }
+
+    NO_DISCARD std::chrono::nanoseconds total() const noexcept {
+        return load + parse + merge + index;
+    }
+
+    // fills in what can be read off the finished document. lazy values
+    // are converted to be counted, so that one that fails to is an ERR
+    // rather than the type its token looked like.
+    void count(const document& doc) noexcept {
+        sections = doc.sections.size();
+        kvs = doc.kvs.size();
+        values.fill(0);
+        const kv::storage st = doc.storage();
+        for (const auto& p : doc.kvs)
+            ++values[value_index(p.val.kind(st))];
+    }
+};
+
+struct parse_options {
+    // threads to parse with; 1 parses sequentially on the calling thread
+    unsigned threads = 1;
+    // upstream of the document's arena; nullptr uses the default resource
+    std::pmr::memory_resource* resource = nullptr;
+    // buffers are not split into chunks smaller than this
+    std::size_t min_chunk = 1 << 20;
+    // interns keys in this table instead of a new one per document, so 
+    // that documents agree on symbol ids
+    std::shared_ptr<symbol_table> symbols;
+    // only tokenize values, converting each on its first typed access, so
+    // that parsing costs little more than finding the keys. values that 
+    // fail to convert are kept, and fail with LOOKUP_ERROR::INVALID_VALUE
+    // rather than being reported to on_error().
+    bool lazy = false;
+    // receives a diagnostic for each invalid line, and may stop the parse;
+    // without one, invalid lines are skipped silently. a reloader rejects
+    // one, since it always builds whole documents.
+    ::diagnostics* diagnostics = nullptr;
+    // filled in by the parse if CONFPARSE_STATS is defined; left alone 
+    // otherwise
+    parse_stats* stats = nullptr;
+};
+
+// what one worker of a parallel parse found in its chunk. headers records
+// each section header along with the number of kvs that preceded it, 
+// errors each diagnostic along with the number of headers and kvs that
+// preceded it, and arrays the elements of the chunk's arrays.
+struct parsed_chunk {
+    struct error {
+        std::size_t headers;
+        std::size_t kvs;
+        diagnostic d;  // its line is relative to the chunk
+    };
+
+    std::vector<kv::pair> kvs;
+    std::vector<std::pair<std::size_t, std::string_view>> headers;
+    std::vector<error> errors;
+    kv::array_pool arrays;
+    std::size_t lines = 0;
+
+    void on_section(std::string_view path) {
+        headers.emplace_back(kvs.size(), path);
+    }
+
+    void on_kv(std::string_view key, const kv::value_ref& v) {
+        kv::pair p;
+        p.key = key;
+        p.val = arrays.adopt(*v.v, v.st);
+        kvs.push_back(p);
+    }
+
+    void on_error(const diagnostic& d) {
+        errors.push_back({ headers.size(), kvs.size(), d });
+    }
+};
+
+// splits buf into about n chunks that each end just after a newline. a
+// quoted string cannot span lines in this format, so no chunk boundary can
+// fall inside one.
+NO_DISCARD inline std::vector<std::size_t> 
+split_at_newlines(std::string_view buf, std::size_t n) {
+    std::vector<std::size_t> bounds{ 0 };
+    const std::size_t step = buf.size() / std::max<std::size_t>(n, 1);
+    while (bounds.back() < buf.size()) {
+        std::size_t at = bounds.back() + std::max<std::size_t>(step, 1);
+        if (at < buf.size()) {
+            at = buf.find('\n', at);
+            at = at == std::string_view::npos ? buf.size() : at + 1;
+        }
+        bounds.push_back(std::min(at, buf.size()));
+    }
+    return bounds;
+}
+
+// parses buf into doc. buf must outlive doc; parse_document() arranges this
+// by keeping the buffer in the document.
+//
+// with more than one thread, buf is split at newlines and the chunks are
+// scanned, tokenized and classified concurrently. a sequential merge then
+// replays their headers and kvs through the builder in file order, so the
+// document is identical to a sequential parse.
+inline void 
+parse_buffer(std::string_view buf, document& doc, const parse_options& o = {}) {
+    if (o.symbols)
+        doc.symbols = o.symbols;
+    document_builder builder(doc);
+    builder.set_diagnostics(o.diagnostics);
+    doc.text = buf;
+
+    // every use is guarded by STATS_ENABLED, so that all of this folds away
+    parse_stats* const stats = o.stats;
+    util::phase_timer timer;
+    std::size_t lines = 0;
+    auto finish = [&] {
+        builder.finish();
+        if (STATS_ENABLED && stats) {
+            stats->index = timer.lap();
+            stats->bytes = buf.size();
+            stats->lines = lines;
+            stats->errors = builder.errors();
+            stats->count(doc);
+        }
+    };
+    if (STATS_ENABLED && stats)
+        *stats = {};
+
+    const std::size_t max_chunks = 
+        buf.size() / std::max<std::size_t>(o.min_chunk, 1);
+    if (o.threads <= 1 || max_chunks < 2) {
+        line_scanner sc(buf);
+        parse_lines(sc, builder, o.lazy);
+        if (STATS_ENABLED && stats) {
+            stats->parse = timer.lap();
+            lines = sc.lines();
+        }
+        finish();
+        return;
+    }
+
+    // a few chunks per thread so that uneven chunks balance out
+    const std::vector<std::size_t> bounds = split_at_newlines(
+        buf, std::min<std::size_t>(max_chunks, o.threads * 4ULL));
+    std::vector<parsed_chunk> chunks(bounds.size() - 1);
+
+    util::parallel_for(chunks.size(), o.threads, [&](std::size_t i) {
+        line_scanner sc(buf, bounds[i], bounds[i + 1]);
+        parse_lines(sc, chunks[i], o.lazy);
+        chunks[i].lines = sc.lines();
+    });
+    if (STATS_ENABLED && stats)
+        stats->parse = timer.lap();
+
+    std::size_t total = 0;
+    for (const auto& c : chunks)
+        total += c.kvs.size();
+    doc.kvs.reserve(total);
+
+    // the events of each chunk are replayed in the order they were found,
+    // so that a sink stopping the parse sees what a sequential one would
+    std::size_t lines_before = 0;
+    for (const auto& c : chunks) {
+        const std::span<const kv::pair> kvs = c.kvs;
+        const kv::storage st = c.arrays.storage_of(buf);
+        std::size_t done = 0;
+        std::size_t header = 0;
+        auto replay = [&](std::size_t headers, std::size_t at) {
+            for (; header != headers; ++header) {
+                const auto& [before, path] = c.headers[header];
+                builder.on_kvs(kvs.subspan(done, before - done), st);
+                builder.on_section(path);
+                done = before;
+            }
+            builder.on_kvs(kvs.subspan(done, at - done), st);
+            done = at;
+        };
+        for (const auto& e : c.errors) {
+            replay(e.headers, e.kvs);
+            diagnostic d = e.d;
+            d.line += static_cast<std::uint32_t>(lines_before);
+            if (!builder.on_error(d)) {
+                lines = lines_before + e.d.line;
+                if (STATS_ENABLED && stats)
+                    stats->merge = timer.lap();
+                finish();
+                return;
+            }
+        }
+        replay(c.headers.size(), kvs.size());
+        lines_before += c.lines;
+    }
+    lines = lines_before;
+    if (STATS_ENABLED && stats)
+        stats->merge = timer.lap();
+    finish();
+}
+
+NO_DISCARD inline document 
+parse_document(file_buffer buf, const parse_options& o = {}) {
+    std::pmr::memory_resource* upstream = o.resource != nullptr ? 
+        o.resource : 
+        std::pmr::get_default_resource();
+    if (!STATS_ENABLED || o.stats == nullptr) {
+        document doc(upstream);
+        doc.buffer = std::move(buf);
+        parse_buffer(doc.buffer.view(), doc, o);
+        return doc;
+    }
+
+    // the document's allocations are counted on their way upstream
+    auto counter = std::make_unique<util::counting_resource>(upstream);
+    const util::counting_resource& c = *counter;
+    document doc(counter.get());
+    doc.owned_upstream = std::move(counter);
+    doc.buffer = std::move(buf);
+    parse_buffer(doc.buffer.view(), doc, o);
+    o.stats->allocations = c.allocations();
+    o.stats->allocated_bytes = c.allocated();
+    o.stats->peak_bytes = c.peak();
+    o.stats->document_bytes = c.in_use();
+    return doc;
+}
+
+NO_DISCARD inline document 
+parse_file(std::string_view path, const parse_options& o = {}) {
+    util::phase_timer timer;
+    file_buffer buf = load_file(path);
+    const std::chrono::nanoseconds load = timer.lap();
+    document doc = parse_document(std::move(buf), o);
+    if (STATS_ENABLED && o.stats != nullptr)
+        o.stats->load = load;
+    return doc;
+}
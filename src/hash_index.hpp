@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <bit>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "util.hpp"
+
+namespace util {
+
+// murmur3 finalizer, so every input bit reaches the low bits used for
+// bucket selection
+NO_DISCARD constexpr std::uint64_t hash_int(std::uint64_t h) noexcept {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// fast non-cryptographic hash of a byte string, eight bytes at a time
+NO_DISCARD constexpr std::uint64_t
+hash_bytes(std::string_view s, std::uint64_t seed = 0) noexcept {
+    constexpr std::uint64_t K = 0x9e3779b97f4a7c15ULL;
+    std::uint64_t h = seed ^ (s.size() * K);
+
+    auto load = [&](std::size_t i, std::size_t n) {
+        std::uint64_t w = 0;
+        // whole words in one load at run time; the result is the same
+        // little-endian value the byte loop below assembles
+        if (!std::is_constant_evaluated() && n == 8) {
+            std::memcpy(&w, s.data() + i, 8);
+            if constexpr (std::endian::native == std::endian::big)
+                w = std::byteswap(w);
+            return w;
+        }
+        for (std::size_t b = 0; b < n; ++b)
+            w |= static_cast<std::uint64_t>(
+                static_cast<unsigned char>(s[i + b])) << (8 * b);
+        return w;
+    };
+
+    std::size_t i = 0;
+    for (; i + 8 <= s.size(); i += 8) {
+        h = (h ^ load(i, 8)) * K;
+        h ^= h >> 32;
+    }
+    if (i < s.size()) {
+        h = (h ^ load(i, s.size() - i)) * K;
+        h ^= h >> 32;
+    }
+
+    return hash_int(h);
+}
+
+} // namespace util
+
+// open-addressing (linear probing) table from 64-bit hashes to 32-bit
+// indexes into some caller-owned array. each slot keeps the upper half of
+// the hash so that most mismatches are rejected without touching the
+// caller's data; callers confirm a match with their own equality test.
+class hash_index {
+public:
+    static constexpr std::uint32_t EMPTY = 0xffffffffU;
+
+    explicit hash_index(
+        std::pmr::memory_resource* r = std::pmr::get_default_resource())
+        : slots_(r)
+    {
+
+    }
+
+    // sizes the table for n entries at a load factor of at most 1/2
+    void reset(std::size_t n) {
+        const std::size_t cap = std::bit_ceil(n * 2 < 8 ? 8 : n * 2);
+        slots_.assign(cap, slot{ 0, EMPTY });
+        borrowed_ = {};
+        mask_ = cap - 1;
+    }
+
+    // inserts index under h, replacing an existing entry that eq() accepts
+    template<typename Eq>
+    void insert(std::uint64_t h, std::uint32_t index, Eq&& eq) {
+        const auto tag = static_cast<std::uint32_t>(h >> 32);
+        for (std::size_t i = h & mask_; ; i = (i + 1) & mask_) {
+            slot& s = slots_[i];
+            if (s.index == EMPTY || (s.tag == tag && eq(s.index))) {
+                s = { tag, index };
+                return;
+            }
+        }
+    }
+
+    // returns the index stored under h that eq() accepts, or EMPTY
+    template<typename Eq>
+    NO_DISCARD std::uint32_t find(std::uint64_t h, Eq&& eq) const noexcept {
+        const std::span<const slot> table = slots();
+        if (table.empty())
+            return EMPTY;
+
+        const auto tag = static_cast<std::uint32_t>(h >> 32);
+        for (std::size_t i = h & mask_; ; i = (i + 1) & mask_) {
+            const slot& s = table[i];
+            if (s.index == EMPTY)
+                return EMPTY;
+            if (s.tag == tag && eq(s.index))
+                return s.index;
+        }
+    }
+
+    NO_DISCARD std::size_t capacity() const noexcept { return slots().size(); }
+
+    struct slot {
+        std::uint32_t tag;
+        std::uint32_t index;
+    };
+
+    // the raw table, so that an index can be saved and restored without
+    // rehashing every key
+    NO_DISCARD std::span<const slot> slots() const noexcept {
+        return borrowed_.empty() ? std::span<const slot>(slots_) : borrowed_;
+    }
+
+    // restores a table previously returned by slots(). returns false if s
+    // cannot be one: its size must be a power of two, at least 8, with at
+    // least one empty slot so that probing terminates.
+    bool assign(std::span<const slot> s) {
+        if (!valid(s))
+            return false;
+
+        slots_.assign(s.begin(), s.end());
+        borrowed_ = {};
+        mask_ = s.size() - 1;
+        return true;
+    }
+
+    // as assign(), but reads s in place, such as from a mapped file, rather
+    // than copying it. s must outlive the index, or its next reset(), and 
+    // nothing may be inserted meanwhile.
+    bool borrow(std::span<const slot> s) {
+        if (!valid(s))
+            return false;
+
+        slots_.clear();
+        borrowed_ = s;
+        mask_ = s.size() - 1;
+        return true;
+    }
+
+private:
+    NO_DISCARD static bool valid(std::span<const slot> s) noexcept {
+        return s.size() >= 8 && std::has_single_bit(s.size()) &&
+               std::any_of(s.begin(), s.end(), 
+                           [](const slot& x) { return x.index == EMPTY; });
+    }
+
+    std::pmr::vector<slot> slots_;
+    std::span<const slot> borrowed_;  // read instead of slots_ if set
+    std::size_t mask_ = 0;
+};
@@ -0,0 +1,462 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <compare>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "util.hpp"
+#include "loader.hpp"
+#include "parallel.hpp"
+#include "stats.hpp"
+#include "confparse.hpp"
+
+// configs split across files. a file includes another with a directive,
+// either a kv keyed include in any section:
+//
+//     [net]
+//     include = "net.conf"
+//
+// which mounts the included file under that section, so that its global
+// kvs belong to [net] and its [tls] becomes [net.tls], or a kv in the
+// [include] section, which mounts the file at the includer's own root:
+//
+//     [include]
+//     base = "base.conf"
+//     local = ["a.conf", "b.conf"]
+//
+// a directive's value is a path, or an array of them, relative to the
+// directory of the file it is in. the included kvs take the directive's
+// place, so they override what comes before it in its section and are
+// overridden by what comes after; the directives themselves are not kept.
+namespace include {
+
+NO_DISCARD constexpr bool IS_INCLUDE_SECTION(std::string_view path) noexcept {
+    return path == "include";
+}
+
+NO_DISCARD constexpr bool IS_INCLUDE_KEY(std::string_view key) noexcept {
+    return key == "include";
+}
+
+// identifies a file however it is named: by device and inode where there
+// are such things, by canonical path otherwise. lazy and eager parses of
+// the same file are different entries.
+struct file_key {
+    std::uint64_t device = 0;
+    std::uint64_t inode = 0;
+    std::string path;
+    bool lazy = false;
+
+    auto operator<=>(const file_key&) const = default;
+};
+
+// what a file looked like when it was parsed
+struct file_stamp {
+    std::int64_t mtime = 0;
+    std::uintmax_t size = 0;
+
+    bool operator==(const file_stamp&) const = default;
+};
+
+// throws std::runtime_error if path cannot be stat'ed
+inline void identify(const std::string& path,
+                     bool lazy,
+                     file_key& key,
+                     file_stamp& stamp) {
+    std::error_code ec;
+    const auto t = std::filesystem::last_write_time(path, ec);
+    if (!ec)
+        stamp.size = std::filesystem::file_size(path, ec);
+    if (ec)
+        throw std::runtime_error(util::format("failed to stat {}.", path));
+    stamp.mtime = static_cast<std::int64_t>(t.time_since_epoch().count());
+
+    key.lazy = lazy;
+#ifdef HAS_MMAP
+    struct stat st {};
+    if (::stat(path.c_str(), &st) != 0)
+        throw std::runtime_error(util::format("failed to stat {}.", path));
+    key.device = static_cast<std::uint64_t>(st.st_dev);
+    key.inode = static_cast<std::uint64_t>(st.st_ino);
+#else
+    key.path = std::filesystem::weakly_canonical(path).string();
+#endif
+}
+
+} // namespace include
+
+// documents of included files, each parsed once per process however many
+// configs include it. an entry is parsed again if its file's size or
+// modification time has changed. thread-safe: a file wanted by several
+// threads at once is parsed by the first, and the others wait for it.
+class include_cache {
+public:
+    using document_ptr = std::shared_ptr<const document>;
+
+    // the cache used by parse_file_with_includes() unless given another
+    NO_DISCARD static include_cache& shared() {
+        static include_cache c;
+        return c;
+    }
+
+    // the document of the file at path, parsed with o if it is not cached.
+    // o's diagnostics, stats and symbols are not used: the document is
+    // shared, so invalid lines are skipped and keys have their own table.
+    NO_DISCARD document_ptr get(const std::string& path, const parse_options& o) {
+        include::file_key key;
+        include::file_stamp stamp;
+        include::identify(path, o.lazy, key, stamp);
+
+        std::shared_future<document_ptr> cached;
+        std::promise<document_ptr> parsed;
+        {
+            const std::lock_guard lock(mutex_);
+            const auto it = files_.find(key);
+            if (it != files_.end() && it->second.stamp == stamp)
+                cached = it->second.doc;
+            else
+                files_.insert_or_assign(key, entry{ stamp, parsed.get_future().share() });
+        }
+        // waits, outside the lock, if another thread is still parsing it
+        if (cached.valid())
+            return cached.get();
+
+        try {
+            parse_options fo;
+            fo.threads = o.threads;
+            fo.min_chunk = o.min_chunk;
+            fo.lazy = o.lazy;
+            auto d = std::make_shared<const document>(parse_file(path, fo));
+            parsed.set_value(d);
+            return d;
+        } catch (...) {
+            parsed.set_exception(std::current_exception());
+            const std::lock_guard lock(mutex_);
+            if (const auto it = files_.find(key);
+                it != files_.end() && it->second.stamp == stamp)
+                files_.erase(it);
+            throw;
+        }
+    }
+
+    NO_DISCARD std::size_t size() const {
+        const std::lock_guard lock(mutex_);
+        return files_.size();
+    }
+
+    // documents still in use elsewhere live on
+    void clear() {
+        const std::lock_guard lock(mutex_);
+        files_.clear();
+    }
+
+private:
+    struct entry {
+        include::file_stamp stamp;
+        std::shared_future<document_ptr> doc;
+    };
+
+    mutable std::mutex mutex_;
+    std::map<include::file_key, entry> files_;
+};
+
+namespace include {
+
+// a file of the include graph. the root is node 0.
+struct node {
+    std::string path;
+    include_cache::document_ptr doc;
+    // (index in doc->kvs of a directive, node it includes), in kv order
+    std::vector<std::pair<std::uint32_t, std::size_t>> includes;
+    std::size_t base = 0;  // where the file's text begins in the composite
+};
+
+// assembles the document of a config and the files it includes
+class composer {
+public:
+    composer(std::vector<node>& nodes, document& doc)
+        : nodes_(nodes),
+          doc_(doc),
+          builder_(doc)
+    {
+
+    }
+
+    void run() {
+        std::vector<bool> open(nodes_.size(), false);
+        emit(0, "", open);
+        builder_.finish();
+    }
+
+private:
+    // emits the sections and kvs of node n mounted under prefix
+    void emit(std::size_t n, std::string_view prefix, std::vector<bool>& open) {
+        if (open[n])
+            throw std::runtime_error(cycle(n));
+        open[n] = true;
+        stack_.push_back(n);
+
+        const node& f = nodes_[n];
+        const document& d = *f.doc;
+        const kv::storage st = d.storage();
+        const auto delta = static_cast<std::ptrdiff_t>(f.base);
+        auto next = f.includes.begin();
+
+        for (section_id id = 0; id < d.sections.size(); ++id) {
+            const section& s = d.sections[id];
+            const bool directives = id != 0 && IS_INCLUDE_SECTION(s.path);
+            const std::string_view at = directives ? prefix : mount(f, prefix, s.path);
+            if (!directives)
+                builder_.on_section(at);
+
+            const auto kvs = d.kvs_of(id);
+            std::size_t run = 0;  // start of the kvs not yet emitted
+            for (std::size_t i = 0; i < kvs.size(); ++i) {
+                const auto k = static_cast<std::uint32_t>(s.first_kv + i);
+                if (next == f.includes.end() || next->first != k)
+                    continue;
+
+                copy(d, kvs.subspan(run, i - run), st, delta);
+                for (; next != f.includes.end() && next->first == k; ++next) {
+                    emit(next->second, at, open);
+                    builder_.on_section(at);
+                }
+                run = i + 1;
+            }
+            copy(d, kvs.subspan(run), st, delta);
+        }
+
+        stack_.pop_back();
+        open[n] = false;
+    }
+
+    // copies kvs of d, rebased into the composite text, as reload does
+    void copy(const document& d,
+              std::span<const kv::pair> kvs,
+              const kv::storage& st,
+              std::ptrdiff_t delta) {
+        if (kvs.empty())
+            return;
+        moved_.clear();
+        moved_arrays_.clear();
+        for (const auto& p : kvs) {
+            kv::pair& q = moved_.emplace_back();
+            q.key = rebase(d, p.key, delta);
+            q.val = p.val.type == KV_PAIR_VALUE::ARRAY ?
+                moved_arrays_.adopt(p.val, st, delta) :
+                p.val.shifted(delta);
+        }
+        builder_.on_kvs(moved_, moved_arrays_.storage_of(doc_.text));
+    }
+
+    NO_DISCARD std::string_view rebase(const document& d,
+                                       std::string_view s,
+                                       std::ptrdiff_t delta) const noexcept {
+        const auto at = static_cast<std::ptrdiff_t>(s.data() - d.text.data());
+        return doc_.text.substr(static_cast<std::size_t>(at + delta), s.size());
+    }
+
+    // the path section path of f has when f is mounted under prefix. paths
+    // that are not in the composite text are kept in the document's arena.
+    NO_DISCARD std::string_view mount(const node& f,
+                                      std::string_view prefix,
+                                      std::string_view path) {
+        if (path.empty())
+            return prefix;
+        if (prefix.empty())
+            return rebase(*f.doc, path, static_cast<std::ptrdiff_t>(f.base));
+
+        const std::size_t n = prefix.size() + 1 + path.size();
+        char* p = static_cast<char*>(doc_.arena->allocate(n, 1));
+        std::memcpy(p, prefix.data(), prefix.size());
+        p[prefix.size()] = '.';
+        std::memcpy(p + prefix.size() + 1, path.data(), path.size());
+        return { p, n };
+    }
+
+    NO_DISCARD std::string cycle(std::size_t n) const {
+        std::string s = "include cycle: ";
+        bool in = false;
+        for (const std::size_t i : stack_) {
+            in = in || i == n;
+            if (in)
+                s += util::format("{} -> ", nodes_[i].path);
+        }
+        s += nodes_[n].path;
+        return s;
+    }
+
+    std::vector<node>& nodes_;
+    document& doc_;
+    document_builder builder_;
+    std::vector<std::size_t> stack_;
+    std::vector<kv::pair> moved_;
+    kv::array_pool moved_arrays_;
+};
+
+// the paths d's directive p includes, resolved against dir
+inline void targets(const document& d,
+                    const kv::pair& p,
+                    const std::filesystem::path& dir,
+                    std::vector<std::string>& out) {
+    const kv::value_ref v = d.value_of(p);
+    auto add = [&](const kv::value_ref& e) {
+        const auto s = e.as<std::string_view>();
+        if (!s || s->empty())
+            throw std::runtime_error(util::format(
+                "include: {} is not a path.", p.key));
+        out.push_back((dir / *s).lexically_normal().string());
+    };
+
+    if (v.type() != KV_PAIR_VALUE::ARRAY) {
+        add(v);
+        return;
+    }
+    const auto n = v.v->array_size(v.st);
+    for (std::size_t i = 0; n && i < *n; ++i) {
+        const kv::value e = v.v->element(v.st, i);
+        add({ &e, v.st });
+    }
+}
+
+} // namespace include
+
+// parses the config at path and every file it includes, directly or not,
+// into one document; see include.hpp. the files of each level of the
+// include graph are parsed in parallel, on up to o.threads threads, and
+// come from cache if it has them. the document's text is that of each file
+// once, and doc.sources says where each begins. o's diagnostics only
+// cover the file at path. o's stats describe the whole document, with the
+// included files' parsing counted as parse time and putting the document
+// together as merge time; their invalid lines are not counted as errors.
+// throws std::runtime_error if a file cannot be read, or includes itself,
+// directly or not.
+NO_DISCARD inline document
+parse_file_with_includes(std::string_view path,
+                         const parse_options& o = {},
+                         include_cache& cache = include_cache::shared()) {
+    using namespace include;
+
+    std::vector<node> nodes(1);
+    nodes[0].path = path;
+    auto root = std::make_shared<document>(parse_file(path, o));
+    nodes[0].doc = root;
+    parse_stats* const stats = o.stats;
+    util::phase_timer timer;
+
+    std::map<file_key, std::size_t> known;
+    {
+        file_key k;
+        file_stamp s;
+        identify(nodes[0].path, o.lazy, k, s);
+        known.emplace(std::move(k), 0);
+    }
+
+    // each level is the files first included by the level before it
+    std::vector<std::string> found;
+    for (std::size_t first = 0, last = 1; first != last; ) {
+        for (std::size_t n = first; n < last; ++n) {
+            // nodes grows below, so it is indexed rather than referred to
+            const document& d = *nodes[n].doc;
+            const auto dir = std::filesystem::path(nodes[n].path).parent_path();
+            for (section_id id = 0; id < d.sections.size(); ++id) {
+                const bool all = id != 0 && IS_INCLUDE_SECTION(d.sections[id].path);
+                for (const auto& p : d.kvs_of(id)) {
+                    if (!all && !IS_INCLUDE_KEY(p.key))
+                        continue;
+                    found.clear();
+                    targets(d, p, dir, found);
+                    for (auto& t : found) {
+                        file_key k;
+                        file_stamp s;
+                        identify(t, o.lazy, k, s);
+                        const auto [it, added] = known.try_emplace(k, nodes.size());
+                        if (added)
+                            nodes.push_back({ std::move(t), {}, {}, 0 });
+                        nodes[n].includes.emplace_back(
+                            static_cast<std::uint32_t>(&p - d.kvs.data()),
+                            it->second);
+                    }
+                }
+            }
+            // kvs are grouped by section, so directives may be out of order
+            std::stable_sort(nodes[n].includes.begin(), nodes[n].includes.end(),
+                [](const auto& a, const auto& b) { return a.first < b.first; });
+        }
+
+        first = last;
+        last = nodes.size();
+        // a file parsed alongside others gets one thread of its own
+        parse_options fo = o;
+        if (last - first > 1)
+            fo.threads = 1;
+        util::parallel_for(last - first, o.threads, [&](std::size_t i) {
+            nodes[first + i].doc = cache.get(nodes[first + i].path, fo);
+        });
+    }
+
+    if (STATS_ENABLED && stats)
+        stats->parse += timer.lap();
+
+    if (nodes.size() == 1) {
+        root->sources.push_back({ nodes[0].path, 0 });
+        return std::move(*root);
+    }
+
+    std::size_t size = 0;
+    for (auto& f : nodes) {
+        f.base = size;
+        size += f.doc->text.size();
+    }
+    auto text = std::make_unique<char[]>(std::max<std::size_t>(size, 1));
+    for (const auto& f : nodes)
+        std::memcpy(text.get() + f.base, f.doc->text.data(), f.doc->text.size());
+
+    // with stats, the document's allocations are counted as by
+    // parse_document()
+    std::pmr::memory_resource* upstream = o.resource != nullptr ?
+        o.resource :
+        std::pmr::get_default_resource();
+    std::unique_ptr<util::counting_resource> counter;
+    if (STATS_ENABLED && stats) {
+        counter = std::make_unique<util::counting_resource>(upstream);
+        upstream = counter.get();
+    }
+    const util::counting_resource* const c = counter.get();
+    document doc(upstream);
+    doc.owned_upstream = std::move(counter);
+    doc.symbols = o.symbols;
+    doc.buffer = file_buffer(std::move(text), size);
+    doc.text = doc.buffer.view();
+    for (const auto& f : nodes)
+        doc.sources.push_back({ f.path, f.base });
+
+    include::composer(nodes, doc).run();
+    if (STATS_ENABLED && stats) {
+        stats->merge += timer.lap();
+        stats->bytes = size;
+        stats->lines = static_cast<std::size_t>(
+            std::count(doc.text.begin(), doc.text.end(), '\n'));
+        stats->count(doc);
+        stats->allocations = c->allocations();
+        stats->allocated_bytes = c->allocated();
+        stats->peak_bytes = c->peak();
+        stats->document_bytes = c->in_use();
+    }
+    return doc;
+}
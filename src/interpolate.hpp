@@ -0,0 +1,398 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <expected>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "util.hpp"
+#include "confparse.hpp"
+#include "reload.hpp"
+
+// references inside string values, expanded when the value is read:
+//
+//     [db]
+//     host = db1
+//     port = 5432
+//     [app]
+//     url = "http://${db.host}:${db.port}/${ENV:USER}"
+//
+// ${section.key} is replaced by that kv's value, or ${key} by a global
+// one's, as document::find() would look it up; a string is expanded in
+// turn, and anything else is written as the formatter writes it.
+// ${ENV:NAME} is replaced by an environment variable. $${ stands for a
+// literal ${. strings without ${ are returned as they are.
+enum class INTERPOLATION_ERROR : int8_t {
+    NONE             =  0,
+    NO_SUCH_KEY      = -1,  // a key referred to, or asked for, is missing
+    NO_SUCH_VARIABLE = -2,  // an unset environment variable
+    NOT_A_STRING     = -3,  // the key asked for does not hold a string
+    INVALID_VALUE    = -4,  // a value referred to failed to convert
+    UNTERMINATED     = -5,  // a ${ without its }
+    CYCLE            = -6,  // a value refers back to itself
+    TOO_DEEP         = -7   // references nest deeper than the limit
+};
+
+NO_DISCARD constexpr bool ERROR(INTERPOLATION_ERROR e) noexcept {
+    return e != INTERPOLATION_ERROR::NONE;
+}
+
+inline static const std::map<INTERPOLATION_ERROR, std::string_view>
+INTERPOLATION_ERROR_STR =
+{
+    { INTERPOLATION_ERROR::NONE,             "no error"              },
+    { INTERPOLATION_ERROR::NO_SUCH_KEY,      "no such key"           },
+    { INTERPOLATION_ERROR::NO_SUCH_VARIABLE, "no such variable"      },
+    { INTERPOLATION_ERROR::NOT_A_STRING,     "not a string"          },
+    { INTERPOLATION_ERROR::INVALID_VALUE,    "invalid value"         },
+    { INTERPOLATION_ERROR::UNTERMINATED,     "unterminated ${"       },
+    { INTERPOLATION_ERROR::CYCLE,            "reference cycle"       },
+    { INTERPOLATION_ERROR::TOO_DEEP,         "references too deep"   }
+};
+
+NO_DISCARD constexpr bool
+STRING_NEEDS_INTERPOLATION(std::string_view s) noexcept {
+    return s.find("${") != std::string_view::npos;
+}
+
+// an expanded string value. it shares ownership of the expansion with the
+// interpolator, so it stays valid however long it is kept, even once 
+// invalidate() or clear() has dropped the entry it came from. a string 
+// that needed no expansion is a view of its document, and is only valid 
+// for as long as the document is.
+class interpolated {
+public:
+    interpolated() = default;
+
+    explicit interpolated(std::string_view s) noexcept : view_(s) { }
+
+    explicit interpolated(std::shared_ptr<const std::string> s) noexcept 
+        : owner_(std::move(s)),
+          view_(*owner_)
+    {
+
+    }
+
+    NO_DISCARD std::string_view view() const noexcept { return view_; }
+    NO_DISCARD operator std::string_view() const noexcept { return view_; }
+    NO_DISCARD std::size_t size() const noexcept { return view_.size(); }
+
+    NO_DISCARD friend bool 
+    operator==(const interpolated& a, std::string_view b) noexcept {
+        return a.view_ == b;
+    }
+
+private:
+    std::shared_ptr<const std::string> owner_;
+    std::string_view view_;
+};
+
+// expands the string values of a document on first access and remembers
+// the result, errors included, so that each is expanded once. entries are
+// keyed by path rather than by kv, so they outlive the document version
+// they were expanded from: after a reload, invalidate() drops only those
+// that depend, directly or not, on a key that changed. environment
+// variables are read once and assumed not to change.
+//
+// entries belong to one version of the document, told apart by its
+// generation: the one first read, and then the after of each diff given
+// to invalidate(). any other version, such as an older snapshot a reader
+// still holds, or a newer one published before invalidate() has been
+// called for it, is expanded into entries of its own that invalidate()
+// discards. only the MAX_OTHER_VERSIONS most recent such versions are 
+// kept; an older one is expanded afresh. safe to use from several 
+// threads. an entry already expanded is read under a shared lock; 
+// expanding takes an exclusive one.
+//
+// the memo is kept here rather than in the document: documents are moved
+// into a document_store and read concurrently, and entries outlive the
+// version they were expanded from.
+class interpolator {
+public:
+    static constexpr std::size_t DEFAULT_MAX_DEPTH = 16;
+    static constexpr std::size_t MAX_OTHER_VERSIONS = 4;
+
+    explicit interpolator(std::size_t max_depth = DEFAULT_MAX_DEPTH)
+        : max_depth_(max_depth)
+    {
+
+    }
+
+    // the expanded string value at "section.sub.key", or "key" in the
+    // global section
+    NO_DISCARD std::expected<interpolated, INTERPOLATION_ERROR>
+    get(const document& doc, std::string_view path) {
+        const kv::pair* p = doc.find(path);
+        if (p == nullptr)
+            return std::unexpected(INTERPOLATION_ERROR::NO_SUCH_KEY);
+        const kv::value_ref v = doc.value_of(*p);
+        if (v.type() != KV_PAIR_VALUE::STRING)
+            return std::unexpected(INTERPOLATION_ERROR::NOT_A_STRING);
+        const std::string_view s = *v.as<std::string_view>();
+        if (!STRING_NEEDS_INTERPOLATION(s))
+            return interpolated(s);
+
+        {
+            const std::shared_lock lock(mutex_);
+            if (doc.generation == generation_) {
+                const auto it = current_.entries.find(path);
+                if (it != current_.entries.end())
+                    return result(it->second);
+            }
+        }
+
+        const std::unique_lock lock(mutex_);
+        if (generation_ == 0)
+            generation_ = doc.generation;
+        if (doc.generation == generation_)
+            return resolve(current_, doc, path, s, 0);
+
+        // the oldest version goes first, as the least likely to be read
+        // again
+        auto it = others_.find(doc.generation);
+        if (it == others_.end()) {
+            if (others_.size() == MAX_OTHER_VERSIONS)
+                others_.erase(others_.begin());
+            it = others_.try_emplace(doc.generation).first;
+        }
+        return resolve(it->second, doc, path, s, 0);
+    }
+
+    // drops the entries that depend on the keys d changed between the
+    // version they were expanded from and after, which later calls are
+    // expected to pass. a reloader's subscribers are given both:
+    //
+    //     r.subscribe([&](const document&, const document& after,
+    //                     const document_diff& d) {
+    //         interp.invalidate(after, d);
+    //     });
+    void invalidate(const document& after, const document_diff& d) {
+        const std::unique_lock lock(mutex_);
+        std::string path;
+        for (const key_change& c : d.changes) {
+            path.assign(c.section);
+            if (!path.empty())
+                path += '.';
+            path += c.key;
+            invalidate(current_, path);
+        }
+        generation_ = after.generation;
+        others_.clear();
+    }
+
+    void clear() {
+        const std::unique_lock lock(mutex_);
+        current_ = {};
+        others_.clear();
+        generation_ = 0;
+    }
+
+    // expanded strings and remembered errors of the current version
+    NO_DISCARD std::size_t size() const {
+        const std::shared_lock lock(mutex_);
+        return current_.entries.size();
+    }
+
+    // references recorded between the current version's entries
+    NO_DISCARD std::size_t edges() const {
+        const std::shared_lock lock(mutex_);
+        std::size_t n = 0;
+        for (const auto& [path, ds] : current_.dependents)
+            n += ds.size();
+        return n;
+    }
+
+private:
+    struct string_hash {
+        using is_transparent = void;
+
+        NO_DISCARD std::size_t operator()(std::string_view s) const noexcept {
+            return static_cast<std::size_t>(util::hash_bytes(s));
+        }
+    };
+
+    template<typename T>
+    using string_map = std::unordered_map<std::string, T, string_hash, std::equal_to<>>;
+    using string_set = std::unordered_set<std::string, string_hash, std::equal_to<>>;
+
+    struct entry {
+        std::shared_ptr<const std::string> text;
+        INTERPOLATION_ERROR error = INTERPOLATION_ERROR::NONE;
+        bool expanding = false;  // on the stack of the expansion under way
+        std::vector<std::string> refs;  // the paths it refers to
+    };
+
+    // the entries of one version. dependents holds exactly the reverse of
+    // the entries' refs, so that it shrinks as they are dropped.
+    struct table {
+        string_map<entry> entries;
+        string_map<string_set> dependents;  // path -> entries referring to it
+    };
+
+    NO_DISCARD static std::expected<interpolated, INTERPOLATION_ERROR>
+    result(const entry& e) {
+        if (ERROR(e.error))
+            return std::unexpected(e.error);
+        return interpolated(e.text);
+    }
+
+    // s is the raw string value at path. TOO_DEEP depends on where the
+    // expansion started rather than on the entry, so it is never stored.
+    NO_DISCARD std::expected<interpolated, INTERPOLATION_ERROR>
+    resolve(table& t,
+            const document& doc,
+            std::string_view path,
+            std::string_view s,
+            std::size_t depth) {
+        if (!STRING_NEEDS_INTERPOLATION(s))
+            return interpolated(s);
+
+        if (const auto it = t.entries.find(path); it != t.entries.end()) {
+            if (it->second.expanding)
+                return std::unexpected(INTERPOLATION_ERROR::CYCLE);
+            return result(it->second);
+        }
+        if (depth >= max_depth_)
+            return std::unexpected(INTERPOLATION_ERROR::TOO_DEEP);
+
+        // the entry's node, and so e and its key, stay put however the map
+        // grows; iterators do not
+        const auto it = t.entries.try_emplace(std::string(path)).first;
+        const std::string& key = it->first;
+        entry& e = it->second;
+        e.expanding = true;
+        std::string out;
+        const INTERPOLATION_ERROR err = expand(t, doc, key, s, depth, out);
+        e.expanding = false;
+        if (err == INTERPOLATION_ERROR::TOO_DEEP) {
+            drop(t, std::string(key));
+            return std::unexpected(err);
+        }
+        e.error = err;
+        if (ERROR(err))
+            return std::unexpected(err);
+        e.text = std::make_shared<const std::string>(std::move(out));
+        return interpolated(e.text);
+    }
+
+    NO_DISCARD INTERPOLATION_ERROR expand(table& t,
+                                          const document& doc,
+                                          const std::string& path,
+                                          std::string_view s,
+                                          std::size_t depth,
+                                          std::string& out) {
+        std::size_t i = 0;
+        for (std::size_t at; (at = s.find('$', i)) != std::string_view::npos; ) {
+            out.append(s, i, at - i);
+            if (s.substr(at, 3) == "$${") {
+                out += "${";
+                i = at + 3;
+                continue;
+            }
+            if (s.substr(at, 2) != "${") {
+                out += '$';
+                i = at + 1;
+                continue;
+            }
+
+            const std::size_t close = s.find('}', at + 2);
+            if (close == std::string_view::npos)
+                return INTERPOLATION_ERROR::UNTERMINATED;
+            const std::string_view ref = s.substr(at + 2, close - at - 2);
+            i = close + 1;
+
+            if (ref.starts_with("ENV:")) {
+                const std::string name(ref.substr(4));
+                const char* v = std::getenv(name.c_str());
+                if (v == nullptr)
+                    return INTERPOLATION_ERROR::NO_SUCH_VARIABLE;
+                out += v;
+                continue;
+            }
+
+            // recorded before the lookup, so that adding a missing key
+            // invalidates what failed for want of it
+            refer(t, path, ref);
+            const kv::pair* p = doc.find(ref);
+            if (p == nullptr)
+                return INTERPOLATION_ERROR::NO_SUCH_KEY;
+            const kv::value_ref v = doc.value_of(*p);
+            switch (v.type()) {
+            case KV_PAIR_VALUE::ERR:
+                return INTERPOLATION_ERROR::INVALID_VALUE;
+            case KV_PAIR_VALUE::STRING: {
+                const auto r = resolve(t, doc, ref, *v.as<std::string_view>(), depth + 1);
+                if (!r)
+                    return r.error();
+                out += r->view();
+                break;
+            }
+            default:
+                fmt::format_to(std::back_inserter(out), "{}", v);
+                break;
+            }
+        }
+        out.append(s, i);
+        return INTERPOLATION_ERROR::NONE;
+    }
+
+    // records that the entry at path refers to ref, once
+    static void refer(table& t, const std::string& path, std::string_view ref) {
+        std::vector<std::string>& refs = t.entries.find(path)->second.refs;
+        if (std::find(refs.begin(), refs.end(), ref) != refs.end())
+            return;
+        refs.emplace_back(ref);
+        auto it = t.dependents.find(ref);
+        if (it == t.dependents.end())
+            it = t.dependents.try_emplace(std::string(ref)).first;
+        it->second.insert(path);
+    }
+
+    // removes the entry at path along with the edges it recorded
+    static void drop(table& t, const std::string& path) {
+        const auto it = t.entries.find(path);
+        if (it == t.entries.end())
+            return;
+        for (const auto& ref : it->second.refs) {
+            const auto d = t.dependents.find(ref);
+            if (d == t.dependents.end())
+                continue;
+            d->second.erase(path);
+            if (d->second.empty())
+                t.dependents.erase(d);
+        }
+        t.entries.erase(it);
+    }
+
+    // drops the entry at path and, transitively, those that refer to it
+    static void invalidate(table& t, const std::string& path) {
+        drop(t, path);
+        const auto it = t.dependents.find(path);
+        if (it == t.dependents.end())
+            return;
+        // dropping a dependent removes it from this set
+        const std::vector<std::string> ds(it->second.begin(), it->second.end());
+        for (const auto& d : ds)
+            invalidate(t, d);
+    }
+
+    std::size_t max_depth_;
+    mutable std::shared_mutex mutex_;
+    std::uint64_t generation_ = 0;  // of the version current_ belongs to
+    table current_;
+    std::map<std::uint64_t, table> others_;
+};
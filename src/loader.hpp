@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if defined __unix__ || defined __APPLE__
+#   define HAS_MMAP 1
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#include "util.hpp"
+
+// read-only view of a whole file. the file is memory-mapped where possible,
+// otherwise it is read into a single heap buffer. either way the contents
+// are never copied again; everything parsed from it is a view into data().
+class file_buffer {
+public:
+    using self_type = file_buffer;
+
+    file_buffer() = default;
+
+    // with allow_map false the file is always copied. a mapping sees later
+    // writes made to the file in place, and faults if it is truncated, so
+    // files that are expected to change while in use should be copied.
+    explicit file_buffer(std::string_view path, bool allow_map = true) {
+#ifdef HAS_MMAP
+        if (allow_map && try_map(path))
+            return;
+#else
+        (void)allow_map;
+#endif
+        read_whole(path);
+    }
+
+    // takes over size bytes built in memory, such as text assembled from
+    // several files
+    file_buffer(std::unique_ptr<char[]> data, std::size_t size) noexcept
+        : data_(data.get()),
+          size_(size),
+          owned_(std::move(data))
+    {
+
+    }
+
+    file_buffer(const self_type&) = delete;
+    self_type& operator=(const self_type&) = delete;
+
+    file_buffer(self_type&& o) noexcept
+        : data_(std::exchange(o.data_, nullptr)),
+          size_(std::exchange(o.size_, 0)),
+          mapped_(std::exchange(o.mapped_, false)),
+          owned_(std::move(o.owned_))
+    {
+
+    }
+
+    self_type& operator=(self_type&& o) noexcept {
+        if (this != &o) {
+            release();
+            data_ = std::exchange(o.data_, nullptr);
+            size_ = std::exchange(o.size_, 0);
+            mapped_ = std::exchange(o.mapped_, false);
+            owned_ = std::move(o.owned_);
+        }
+        return *this;
+    }
+
+    ~file_buffer() { release(); }
+
+    NO_DISCARD const char* data() const noexcept { return data_; }
+    NO_DISCARD std::size_t size() const noexcept { return size_; }
+    NO_DISCARD bool mapped() const noexcept { return mapped_; }
+
+    NO_DISCARD std::string_view view() const noexcept {
+        return { data_ == nullptr ? "" : data_, size_ };
+    }
+
+private:
+#ifdef HAS_MMAP
+    // returns false if the file exists but cannot be mapped (pipes, procfs
+    // entries, empty files), in which case the caller falls back to read().
+    bool try_map(std::string_view path) {
+        const std::string p(path);
+        const int fd = ::open(p.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error("failed to open file.");
+
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0) {
+            ::close(fd);
+            return false;
+        }
+
+        void* p_map = ::mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                             PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p_map == MAP_FAILED)
+            return false;
+
+        ::madvise(p_map, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(p_map);
+        size_ = static_cast<std::size_t>(st.st_size);
+        mapped_ = true;
+        return true;
+    }
+#endif
+
+    void read_whole(std::string_view path) {
+        std::ifstream f(std::string(path), std::ios::binary);
+        if (!f)
+            throw std::runtime_error("failed to open file.");
+
+        // read straight into the owned buffer, growing it geometrically for
+        // streams that don't report a size up front.
+        std::size_t cap = 1 << 16;
+        std::size_t len = 0;
+        owned_ = std::make_unique<char[]>(cap);
+        while (f.read(owned_.get() + len, 
+                      static_cast<std::streamsize>(cap - len)) || 
+               f.gcount() > 0) {
+            len += static_cast<std::size_t>(f.gcount());
+            if (len == cap) {
+                auto grown = std::make_unique<char[]>(cap * 2);
+                std::memcpy(grown.get(), owned_.get(), len);
+                owned_ = std::move(grown);
+                cap *= 2;
+            }
+        }
+
+        if (f.bad())
+            throw std::runtime_error("error reading from file.");
+
+        data_ = owned_.get();
+        size_ = len;
+    }
+
+    void release() noexcept {
+#ifdef HAS_MMAP
+        if (mapped_)
+            ::munmap(const_cast<char*>(data_), size_);
+#endif
+        owned_.reset();
+        data_ = nullptr;
+        size_ = 0;
+        mapped_ = false;
+    }
+
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool mapped_ = false;
+    std::unique_ptr<char[]> owned_;
+};
+
+NO_DISCARD inline file_buffer 
+load_file(std::string_view path, bool allow_map = true) {
+    return file_buffer(path, allow_map);
+}
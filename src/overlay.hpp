@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <expected>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "util.hpp"
+#include "loader.hpp"
+#include "symbols.hpp"
+#include "confparse.hpp"
+
+// a kv found in one layer of a layered_document
+struct layer_kv {
+    const kv::pair* kv = nullptr;
+    const document* doc = nullptr;
+    std::size_t layer = 0;  // index in layered_document::layers()
+
+    NO_DISCARD explicit operator bool() const noexcept { return kv != nullptr; }
+
+    NO_DISCARD kv::value_ref value() const noexcept { return doc->value_of(*kv); }
+};
+
+// an ordered stack of documents read as one, such as defaults, a region's
+// config and a host's overrides. sections merge by path, and a key set in
+// a section of a layer hides that key in the same section of every layer
+// below it. reading copies nothing: layers are shared by reference, so 
+// stacks derived from a common base with with() cost the base once plus 
+// their own overlays, and a section no overlay touches is read straight 
+// from the layer that has it. that sharing is of whole layers only; 
+// flatten() builds a document of its own and copies everything into it. a
+// lookup probes each layer's indexes from the top down; layers parsed with
+// the same parse_options::symbols resolve a key to its symbol once rather
+// than once per layer.
+class layered_document {
+public:
+    using document_ptr = std::shared_ptr<const document>;
+
+    layered_document() = default;
+
+    explicit layered_document(document_ptr base) {
+        push(std::move(base));
+    }
+
+    // adds a layer on top of the others
+    void push(document_ptr layer) {
+        layers_.push_back(std::move(layer));
+    }
+
+    // this stack with layer on top, sharing every layer with this one
+    NO_DISCARD layered_document with(document_ptr layer) const {
+        layered_document d = *this;
+        d.push(std::move(layer));
+        return d;
+    }
+
+    // base first
+    NO_DISCARD const std::vector<document_ptr>& layers() const noexcept {
+        return layers_;
+    }
+
+    NO_DISCARD bool has_section(std::string_view path) const noexcept {
+        for (const auto& l : layers_) {
+            if (l->find_section(path) != NO_INDEX)
+                return true;
+        }
+        return false;
+    }
+
+    // the kv key of the section at path, from the topmost layer that has it
+    NO_DISCARD layer_kv find(std::string_view section, std::string_view key) const {
+        lookup k;
+        for (std::size_t i = layers_.size(); i-- != 0; ) {
+            const document& d = *layers_[i];
+            const section_id id = d.find_section(section);
+            if (id == NO_INDEX)
+                continue;
+            if (const kv::pair* p = k.find(d, id, key))
+                return { p, &d, i };
+        }
+        return {};
+    }
+
+    // looks up "section.sub.key", or "key" in the global section
+    NO_DISCARD layer_kv find(std::string_view path) const {
+        const std::size_t dot = path.rfind('.');
+        return dot == std::string_view::npos ?
+            find("", path) :
+            find(path.substr(0, dot), path.substr(dot + 1));
+    }
+
+    // typed lookup of "section.sub.key", or "key" in the global section
+    template<typename T>
+    NO_DISCARD std::expected<T, LOOKUP_ERROR> get(std::string_view path) const {
+        const std::size_t dot = path.rfind('.');
+        const std::string_view section = dot == std::string_view::npos ?
+            std::string_view{} :
+            path.substr(0, dot);
+        if (const layer_kv f = find(path))
+            return f.value().template as<T>();
+        return std::unexpected(has_section(section) ?
+                               LOOKUP_ERROR::NO_SUCH_KEY :
+                               LOOKUP_ERROR::NO_SUCH_SECTION);
+    }
+
+    // calls f(layer, kv) for each kv that a lookup in the section at path
+    // could return, layer by layer from the base up and in file order
+    // within each: every kv of a key comes from the topmost layer that
+    // sets it
+    template<typename F>
+    void for_each_kv(std::string_view path, F&& f) const {
+        for (std::size_t i = 0; i < layers_.size(); ++i) {
+            const document& d = *layers_[i];
+            const section_id id = d.find_section(path);
+            if (id == NO_INDEX)
+                continue;
+            for (const auto& p : d.kvs_of(id)) {
+                if (!hidden(i, path, p.key))
+                    f(i, p);
+            }
+        }
+    }
+
+    // merges the layers into a single new document, which owns a copy of
+    // each layer's text. sections come in the order the layers, from the
+    // base up, first have them, each with the kvs for_each_kv() gives. a 
+    // document keeps its kvs in one array, so none are shared with the
+    // layers, not even those of sections no overlay touches: every visible
+    // kv is copied, at a cost linear in the size of the stack. the document
+    // shares the layers' symbols if they all have the same ones.
+    NO_DISCARD document flatten(
+        std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) const;
+
+private:
+    // resolves a key to a symbol once per symbol table. a layer without
+    // the key says nothing of its symbol in the others, so only a symbol
+    // found is kept.
+    struct lookup {
+        const symbol_table* table = nullptr;
+        symbol_id sym = NO_SYMBOL;
+
+        NO_DISCARD const kv::pair*
+        find(const document& d, section_id id, std::string_view key) noexcept {
+            if (d.symbols.get() != table || sym == NO_SYMBOL) {
+                sym = d.symbol_of(key);
+                table = sym == NO_SYMBOL ? nullptr : d.symbols.get();
+            }
+            return sym == NO_SYMBOL ? nullptr : d.find(id, sym);
+        }
+    };
+
+    // whether a layer above layer sets key in the section at path
+    NO_DISCARD bool hidden(std::size_t layer,
+                           std::string_view path,
+                           std::string_view key) const {
+        lookup k;
+        for (std::size_t i = layer + 1; i < layers_.size(); ++i) {
+            const document& d = *layers_[i];
+            const section_id id = d.find_section(path);
+            if (id != NO_INDEX && k.find(d, id, key) != nullptr)
+                return true;
+        }
+        return false;
+    }
+
+    std::vector<document_ptr> layers_;
+};
+
+inline document layered_document::flatten(std::pmr::memory_resource* upstream) const {
+    document doc(upstream);
+    std::vector<std::size_t> base(layers_.size(), 0);
+    std::size_t size = 0;
+    bool shared_symbols = !layers_.empty();
+    for (std::size_t i = 0; i < layers_.size(); ++i) {
+        base[i] = size;
+        size += layers_[i]->text.size();
+        shared_symbols = shared_symbols &&
+                         layers_[i]->symbols == layers_[0]->symbols;
+    }
+    auto text = std::make_unique<char[]>(std::max<std::size_t>(size, 1));
+    for (std::size_t i = 0; i < layers_.size(); ++i) {
+        const std::string_view t = layers_[i]->text;
+        std::memcpy(text.get() + base[i], t.data(), t.size());
+    }
+    doc.buffer = file_buffer(std::move(text), size);
+    doc.text = doc.buffer.view();
+    if (shared_symbols)
+        doc.symbols = layers_[0]->symbols;
+
+    // s, a view of layer i's text, as the same view of doc's. a path that
+    // is not in the layer's text, as mounted includes are not, is copied
+    // into the document's arena.
+    auto rebase = [&](std::size_t i, std::string_view s) -> std::string_view {
+        const std::string_view t = layers_[i]->text;
+        if (s.data() >= t.data() && s.data() + s.size() <= t.data() + t.size())
+            return doc.text.substr(base[i] + (s.data() - t.data()), s.size());
+        char* p = static_cast<char*>(doc.arena->allocate(s.size(), 1));
+        std::memcpy(p, s.data(), s.size());
+        return { p, s.size() };
+    };
+
+    document_builder builder(doc);
+    std::unordered_set<std::string_view> seen;
+    std::vector<kv::pair> moved;
+    kv::array_pool moved_arrays;
+    for (std::size_t i = 0; i < layers_.size(); ++i) {
+        for (const section& s : layers_[i]->sections) {
+            if (!seen.insert(s.path).second)
+                continue;
+
+            builder.on_section(s.path.empty() ? s.path : rebase(i, s.path));
+            moved.clear();
+            moved_arrays.clear();
+            for_each_kv(s.path, [&](std::size_t j, const kv::pair& p) {
+                const auto delta = static_cast<std::ptrdiff_t>(base[j]);
+                kv::pair& q = moved.emplace_back();
+                q.key = rebase(j, p.key);
+                q.sym = shared_symbols ? p.sym : NO_SYMBOL;
+                q.val = p.val.type == KV_PAIR_VALUE::ARRAY ?
+                    moved_arrays.adopt(p.val, layers_[j]->storage(), delta) :
+                    p.val.shifted(delta);
+            });
+            builder.on_kvs(moved, moved_arrays.storage_of(doc.text));
+        }
+    }
+    builder.finish();
+    return doc;
+}
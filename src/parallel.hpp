@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "util.hpp"
+
+namespace util {
+
+// calls f(i) for every i in [0, count) on up to threads threads, the
+// calling thread included. work is handed out one index at a time, so
+// uneven items balance out. the first exception thrown by f is rethrown
+// once every thread has stopped.
+template<typename F>
+void parallel_for(std::size_t count, unsigned threads, F&& f) {
+    const std::size_t workers =
+        std::min<std::size_t>(std::max(threads, 1U), count);
+    if (workers <= 1) {
+        for (std::size_t i = 0; i < count; ++i)
+            f(i);
+        return;
+    }
+
+    std::atomic<std::size_t> next = 0;
+    std::exception_ptr error;
+    std::mutex error_mutex;
+
+    auto work = [&] {
+        try {
+            for (std::size_t i; (i = next.fetch_add(1)) < count; )
+                f(i);
+        } catch (...) {
+            const std::lock_guard lock(error_mutex);
+            if (!error)
+                error = std::current_exception();
+            next.store(count); // stop handing out work
+        }
+    };
+
+    {
+        std::vector<std::jthread> pool;
+        pool.reserve(workers - 1);
+        for (std::size_t t = 1; t < workers; ++t)
+            pool.emplace_back(work);
+        work();
+    }
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+NO_DISCARD inline unsigned hardware_threads() noexcept {
+    const unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+} // namespace util
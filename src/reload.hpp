@@ -0,0 +1,599 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cerrno>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#if defined __linux__
+#   define HAS_INOTIFY 1
+#   include <poll.h>
+#   include <sys/inotify.h>
+#   include <unistd.h>
+#endif
+
+#include "util.hpp"
+#include "loader.hpp"
+#include "hash_index.hpp"
+#include "structural.hpp"
+#include "confparse.hpp"
+#include "snapshot.hpp"
+
+// waits for a file to be rewritten. the directory is watched rather than the
+// file itself so that editors and deploy tools that replace the file by
+// renaming a new one over it are seen too. where inotify is unavailable the
+// file's size and modification time are polled instead.
+class file_watcher {
+public:
+    using self_type = file_watcher;
+
+    static constexpr std::chrono::milliseconds POLL_INTERVAL{ 100 };
+
+    explicit file_watcher(std::string_view path) : path_(path) {
+        stamp(size_, mtime_);
+#ifdef HAS_INOTIFY
+        const std::filesystem::path p(path_);
+        const std::filesystem::path dir =
+            p.has_parent_path() ? p.parent_path() : ".";
+        name_ = p.filename().string();
+
+        fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd_ >= 0 &&
+            ::inotify_add_watch(fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+#endif
+    }
+
+    file_watcher(const self_type&) = delete;
+    self_type& operator=(const self_type&) = delete;
+
+    ~file_watcher() {
+#ifdef HAS_INOTIFY
+        if (fd_ >= 0)
+            ::close(fd_);
+#endif
+    }
+
+    // returns true once the file has changed, or false if timeout passes
+    // first. several changes in quick succession are reported once.
+    bool wait(std::chrono::milliseconds timeout) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+#ifdef HAS_INOTIFY
+        if (fd_ >= 0)
+            return wait_inotify(deadline);
+#endif
+        for (;;) {
+            std::uintmax_t size = 0;
+            std::int64_t mtime = 0;
+            stamp(size, mtime);
+            if (size != size_ || mtime != mtime_) {
+                size_ = size;
+                mtime_ = mtime;
+                return true;
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            if (now >= deadline)
+                return false;
+            std::this_thread::sleep_for(std::min<std::chrono::nanoseconds>(
+                POLL_INTERVAL, deadline - now));
+        }
+    }
+
+private:
+    void stamp(std::uintmax_t& size, std::int64_t& mtime) const noexcept {
+        std::error_code ec;
+        size = std::filesystem::file_size(path_, ec);
+        const auto t = std::filesystem::last_write_time(path_, ec);
+        mtime = ec ? 0 : static_cast<std::int64_t>(t.time_since_epoch().count());
+    }
+
+#ifdef HAS_INOTIFY
+    bool wait_inotify(std::chrono::steady_clock::time_point deadline) {
+        bool changed = false;
+        for (;;) {
+            // once a change has been seen, only drain what is already queued
+            int ms = 0;
+            if (!changed) {
+                const auto left = deadline - std::chrono::steady_clock::now();
+                ms = static_cast<int>(std::max<std::int64_t>(0,
+                    std::chrono::ceil<std::chrono::milliseconds>(left).count()));
+            }
+
+            pollfd p{ fd_, POLLIN, 0 };
+            const int n = ::poll(&p, 1, ms);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return changed;
+
+            alignas(inotify_event) char buf[4096];
+            const ssize_t len = ::read(fd_, buf, sizeof(buf));
+            if (len <= 0)
+                return changed;
+
+            for (ssize_t i = 0; i < len; ) {
+                const auto* e = reinterpret_cast<const inotify_event*>(buf + i);
+                if (e->len > 0 && name_ == e->name)
+                    changed = true;
+                i += static_cast<ssize_t>(sizeof(inotify_event) + e->len);
+            }
+        }
+    }
+
+    std::string name_;  // file name within the watched directory
+    int fd_ = -1;
+#endif
+
+    std::string path_;
+    std::uintmax_t size_ = 0;
+    std::int64_t mtime_ = 0;
+};
+
+namespace reload {
+
+// a stretch of text from one valid section header up to the next. the first
+// block holds whatever precedes the first header and has no header of its
+// own. an invalid header does not start a block, just as it does not change
+// the section that following kvs belong to.
+struct block {
+    std::string_view path;      // section the block's kvs belong to
+    std::size_t begin = 0;
+    std::size_t end = 0;
+    std::uint64_t hash = 0;     // of text[begin, end)
+    std::size_t lines = 0;      // newlines in text[begin, end)
+    // the block's kvs are kvs_of(path)[kv_offset, kv_offset + kv_count)
+    std::uint32_t kv_offset = 0;
+    std::uint32_t kv_count = 0;
+};
+
+// if line is a valid section header, as parse_lines() would see it, stores
+// its path and returns true. a quote anywhere makes a header invalid, so
+// quoted comment characters need no special treatment here.
+NO_DISCARD inline bool
+header_line(std::string_view line, std::string_view& path) noexcept {
+    std::size_t i = 0;
+    while (i < line.size() && CHAR_IS_WHITESPACE(line[i]))
+        ++i;
+    if (i == line.size() || line[i] != '[')
+        return false;
+
+    std::size_t end = line.find_first_of(
+        std::string_view(COMMENT_CHARS.data(), COMMENT_CHARS.size()), i);
+    if (end == std::string_view::npos)
+        end = line.size();
+    while (end > i && CHAR_IS_WHITESPACE(line[end - 1]))
+        --end;
+    return !ERROR(parse_section_header(line.substr(i, end - i), path));
+}
+
+// splits text into blocks at each valid section header and hashes them.
+// only lines starting with '[' are looked at, so this runs far faster than
+// a parse.
+NO_DISCARD inline std::vector<block> split_blocks(std::string_view text) {
+    std::vector<block> blocks(1);
+    for (std::size_t i = 0; (i = text.find('[', i)) != std::string_view::npos; ) {
+        const std::size_t rn = text.rfind('\n', i);
+        const std::size_t line_begin = rn == std::string_view::npos ? 0 : rn + 1;
+        std::size_t line_end = text.find('\n', i);
+        if (line_end == std::string_view::npos)
+            line_end = text.size();
+
+        std::string_view path;
+        if (std::all_of(text.begin() + line_begin, text.begin() + i,
+                        CHAR_IS_WHITESPACE) &&
+            header_line(text.substr(line_begin, line_end - line_begin), path)) {
+            blocks.back().end = line_begin;
+            block& b = blocks.emplace_back();
+            b.path = path;
+            b.begin = line_begin;
+        }
+        i = line_end;
+    }
+    blocks.back().end = text.size();
+
+    for (auto& b : blocks) {
+        const std::string_view s = text.substr(b.begin, b.end - b.begin);
+        b.hash = util::hash_bytes(s);
+        b.lines = static_cast<std::size_t>(std::count(s.begin(), s.end(), '\n'));
+    }
+    return blocks;
+}
+
+} // namespace reload
+
+enum class CHANGE : int8_t {
+    ADDED   = 1,
+    REMOVED = 2,
+    CHANGED = 3
+};
+
+// a key whose value differs between two versions of a document. before
+// points into the old version and after into the new one.
+struct key_change {
+    CHANGE what;
+    std::string_view section;
+    std::string_view key;
+    const kv::pair* before = nullptr;  // nullptr if ADDED
+    const kv::pair* after = nullptr;   // nullptr if REMOVED
+};
+
+struct document_diff {
+    std::vector<key_change> changes;
+    std::size_t blocks_reused = 0;
+    std::size_t blocks_parsed = 0;
+
+    NO_DISCARD bool empty() const noexcept { return changes.empty(); }
+};
+
+// keeps a document in step with the file it was parsed from. a reload
+// splits the new text into blocks at section headers and compares their
+// hashes with those of the previous version. unchanged blocks keep their
+// parsed kvs, moved to where the block now lies in the new text; only the
+// rest are parsed, on up to parse_options::threads threads. subscribers are
+// then told which keys were added, removed or changed. the resulting 
+// document is the same as a full parse.
+//
+// reuse saves scanning, tokenizing and converting a block, not storing it:
+// each version owns its text and arena, so that it can be retired on its
+// own, and a reused block's kvs and array elements are copied into the new
+// version rather than shared with the old one.
+//
+// each version is published through a document_store, from which other
+// threads read snapshots without locking. reloads happen on the thread that
+// calls poll() or reload(). files are copied rather than mapped, since they
+// are expected to change while in use.
+class reloader {
+public:
+    using subscriber = std::function<void(const document& before,
+                                          const document& after,
+                                          const document_diff& diff)>;
+
+    // every version shares o.symbols, or one table of the reloader's own,
+    // so a key keeps its symbol across reloads. throws 
+    // std::invalid_argument if o has diagnostics: a reload always builds a
+    // whole document, and does not see the invalid lines of the blocks it
+    // reuses again.
+    explicit reloader(std::string path, const parse_options& o = {})
+        : path_(std::move(path)),
+          opts_(checked(o)),
+          watcher_(path_),
+          store_(load())
+    {
+
+    }
+
+    // the latest version, for the reloading thread
+    NO_DISCARD const document& current() const noexcept { 
+        return store_.latest(); 
+    }
+
+    // where other threads read the latest version from
+    NO_DISCARD document_store& store() noexcept { return store_; }
+
+    // f is called after every reload, before the new version is published
+    // and while both are alive. the
+    // views and pointers in the diff are only valid for the duration of
+    // the call.
+    void subscribe(subscriber f) { subscribers_.push_back(std::move(f)); }
+
+    // waits up to timeout for the file to change and reloads it if it does.
+    // returns whether it reloaded.
+    bool poll(std::chrono::milliseconds timeout = {}) {
+        if (!watcher_.wait(timeout))
+            return false;
+        reload();
+        return true;
+    }
+
+    // reloads the file now. if it cannot be read the current document is
+    // kept and the exception propagates. returns whether any key changed.
+    bool reload() {
+        const document& old = store_.latest();
+        std::vector<reload::block> blocks;
+        document_diff d;
+        document next = rebuild(&old, blocks, d);
+
+        for (const auto& f : subscribers_)
+            f(old, next, d);
+
+        store_.publish(std::move(next));
+        blocks_ = std::move(blocks);
+        return !d.empty();
+    }
+
+private:
+    // a run of blocks [first, last) that could not be reused, and what
+    // parsing it found
+    struct parsed_run {
+        std::size_t first = 0;
+        std::size_t last = 0;
+        parsed_chunk chunk;
+    };
+
+    NO_DISCARD static parse_options checked(parse_options o) {
+        if (o.diagnostics != nullptr)
+            throw std::invalid_argument("a reloader cannot take diagnostics.");
+        if (!o.symbols)
+            o.symbols = std::make_shared<symbol_table>();
+        return o;
+    }
+
+    NO_DISCARD std::pmr::memory_resource* resource() const noexcept {
+        return opts_.resource != nullptr ?
+            opts_.resource :
+            std::pmr::get_default_resource();
+    }
+
+    NO_DISCARD document load() {
+        document_diff d;
+        return rebuild(nullptr, blocks_, d);
+    }
+
+    // parses the file, reusing what it can of old, whose blocks are blocks_
+    NO_DISCARD document rebuild(const document* old, 
+                                std::vector<reload::block>& blocks, 
+                                document_diff& d) {
+        document doc(resource());
+        doc.symbols = opts_.symbols;
+        doc.buffer = load_file(path_, false);
+        doc.text = doc.buffer.view();
+        blocks = reload::split_blocks(doc.text);
+
+        // blocks are matched by content, wherever they now are
+        std::unordered_multimap<std::uint64_t, std::uint32_t> by_hash;
+        for (std::uint32_t i = 0; old != nullptr && i < blocks_.size(); ++i)
+            by_hash.emplace(blocks_[i].hash, i);
+
+        std::vector<std::uint32_t> match(blocks.size(), NO_INDEX);
+        for (std::size_t j = 0; j < blocks.size(); ++j) {
+            const reload::block& b = blocks[j];
+            const auto [first, last] = by_hash.equal_range(b.hash);
+            for (auto it = first; it != last; ++it) {
+                const reload::block& o = blocks_[it->second];
+                if (o.path == b.path && o.end - o.begin == b.end - b.begin &&
+                    reusable(*old, o)) {
+                    match[j] = it->second;
+                    break;
+                }
+            }
+        }
+
+        // the blocks that could not be reused are parsed first, a run of
+        // them at a time. with more than one thread, runs are cut at block
+        // boundaries into pieces of about min_chunk bytes, and the pieces
+        // parsed concurrently.
+        std::vector<parsed_run> runs;
+        for (std::size_t j = 0; j < blocks.size(); ) {
+            if (match[j] != NO_INDEX) {
+                ++j;
+                continue;
+            }
+            std::size_t k = j;
+            std::size_t bytes = 0;
+            while (k < blocks.size() && match[k] == NO_INDEX &&
+                   (opts_.threads <= 1 || bytes < opts_.min_chunk)) {
+                bytes += blocks[k].end - blocks[k].begin;
+                ++k;
+            }
+            runs.emplace_back().first = j;
+            runs.back().last = k;
+            j = k;
+        }
+        util::parallel_for(runs.size(), opts_.threads, [&](std::size_t i) {
+            parsed_run& r = runs[i];
+            line_scanner sc(doc.text, 
+                            blocks[r.first].begin, 
+                            blocks[r.last - 1].end);
+            parse_lines(sc, r.chunk, opts_.lazy);
+        });
+
+        document_builder builder(doc);
+        std::vector<kv::pair> moved;
+        kv::array_pool moved_arrays;
+        std::size_t lines_before = 0;
+        std::size_t next_run = 0;
+        for (std::size_t j = 0; j < blocks.size(); ) {
+            if (match[j] == NO_INDEX) {
+                const parsed_run& r = runs[next_run++];
+                replay_run(doc.text, r.chunk, 
+                           std::span(blocks).subspan(r.first, r.last - r.first),
+                           r.first == 0, lines_before, builder);
+                d.blocks_parsed += r.last - r.first;
+                j = r.last;
+                continue;
+            }
+
+            reload::block& b = blocks[j];
+            const reload::block& o = blocks_[match[j]];
+            if (j > 0)
+                builder.on_section(b.path);
+            move_kvs(*old, o, doc.text, b, moved, moved_arrays);
+            builder.on_kvs(moved, moved_arrays.storage_of(doc.text));
+            b.kv_count = o.kv_count;
+            lines_before += b.lines;
+            ++d.blocks_reused;
+            ++j;
+        }
+        builder.finish();
+
+        std::vector<std::uint32_t> offsets(doc.sections.size(), 0);
+        for (auto& b : blocks) {
+            const section_id id = doc.find_section(b.path);
+            b.kv_offset = offsets[id];
+            offsets[id] += b.kv_count;
+        }
+
+        if (old != nullptr)
+            diff(*old, doc, blocks, match, d);
+        return doc;
+    }
+
+    // a block can be reused as long as its section is still there to take
+    // its kvs from
+    NO_DISCARD static bool 
+    reusable(const document& old, const reload::block& o) noexcept {
+        return old.find_section(o.path) != NO_INDEX;
+    }
+
+    // copies the kvs of old block o, rebased from old's text to block b of
+    // text, into out, and the elements of their arrays into arrays
+    static void move_kvs(const document& old,
+                         const reload::block& o,
+                         std::string_view text,
+                         const reload::block& b,
+                         std::vector<kv::pair>& out,
+                         kv::array_pool& arrays) {
+        const auto kvs =
+            old.kvs_of(old.find_section(o.path)).subspan(o.kv_offset, o.kv_count);
+        auto rebase = [&](std::string_view s) {
+            const std::size_t at = static_cast<std::size_t>(
+                s.data() - old.text.data()) - o.begin + b.begin;
+            return text.substr(at, s.size());
+        };
+
+        const kv::storage st = old.storage();
+        const std::ptrdiff_t delta = static_cast<std::ptrdiff_t>(b.begin) - 
+                                     static_cast<std::ptrdiff_t>(o.begin);
+        out.clear();
+        arrays.clear();
+        for (const auto& p : kvs) {
+            kv::pair& q = out.emplace_back();
+            q.key = rebase(p.key);
+            q.sym = p.sym;
+            q.val = p.val.type == KV_PAIR_VALUE::ARRAY ?
+                arrays.adopt(p.val, st, delta) :
+                p.val.shifted(delta);
+        }
+    }
+
+    // hands what was parsed of the contiguous blocks bs to builder, 
+    // recording how many kvs each block holds. each block but a leading 
+    // global one starts with the header of its section, so the n-th header
+    // seen begins the n-th such block.
+    static void replay_run(std::string_view text,
+                           const parsed_chunk& c,
+                           std::span<reload::block> bs,
+                           bool global_first,
+                           std::size_t& lines_before,
+                           document_builder& builder) {
+        for (const auto& e : c.errors) {
+            diagnostic d = e.d;
+            d.line += static_cast<std::uint32_t>(lines_before);
+            builder.on_error(d);
+        }
+        for (const auto& b : bs)
+            lines_before += b.lines;
+
+        const std::span<const kv::pair> kvs = c.kvs;
+        const kv::storage st = c.arrays.storage_of(text);
+        const std::size_t skip = global_first ? 1 : 0;
+        std::size_t done = 0;
+        for (std::size_t h = 0; h < c.headers.size(); ++h) {
+            const auto& [at, path] = c.headers[h];
+            builder.on_kvs(kvs.subspan(done, at - done), st);
+            if (h + skip > 0 && h + skip - 1 < bs.size())
+                bs[h + skip - 1].kv_count = static_cast<std::uint32_t>(at - done);
+            builder.on_section(path);
+            done = at;
+        }
+        builder.on_kvs(kvs.subspan(done), st);
+        bs.back().kv_count = static_cast<std::uint32_t>(kvs.size() - done);
+    }
+
+    // a section can only differ if it is no longer made up of the same old
+    // blocks in the same order
+    void diff(const document& old,
+              const document& doc,
+              std::span<const reload::block> blocks,
+              std::span<const std::uint32_t> match,
+              document_diff& d) const {
+        std::unordered_map<std::string_view,
+                           std::pair<std::vector<std::uint32_t>,
+                                     std::vector<std::uint32_t>>> seqs;
+        for (std::uint32_t i = 0; i < blocks_.size(); ++i)
+            seqs[blocks_[i].path].first.push_back(i);
+        for (std::size_t j = 0; j < blocks.size(); ++j)
+            seqs[blocks[j].path].second.push_back(match[j]);
+
+        std::unordered_set<std::string_view> touched;
+        for (const auto& [path, seq] : seqs) {
+            if (seq.first != seq.second)
+                touched.insert(path);
+        }
+        if (touched.empty())
+            return;
+
+        // in the order of the new document, then sections that are gone
+        for (const auto& s : doc.sections) {
+            if (touched.contains(s.path))
+                diff_section(old, doc, s.path, d);
+        }
+        for (const auto& s : old.sections) {
+            if (touched.contains(s.path) && 
+                doc.find_section(s.path) == NO_INDEX)
+                diff_section(old, doc, s.path, d);
+        }
+    }
+
+    // compares the kvs that win lookups of each key in section path
+    static void diff_section(const document& old,
+                             const document& doc,
+                             std::string_view path,
+                             document_diff& d) {
+        const section_id oid = old.find_section(path);
+        const section_id nid = doc.find_section(path);
+
+        if (nid != NO_INDEX) {
+            for (const auto& p : doc.kvs_of(nid)) {
+                if (doc.find(nid, p.key) != &p)
+                    continue;
+                const kv::pair* before = 
+                    oid == NO_INDEX ? nullptr : old.find(oid, p.key);
+                if (before == nullptr) {
+                    d.changes.push_back(
+                        { CHANGE::ADDED, path, p.key, nullptr, &p });
+                } else if (!kv::values_equal(old.value_of(*before), 
+                                             doc.value_of(p))) {
+                    d.changes.push_back(
+                        { CHANGE::CHANGED, path, p.key, before, &p });
+                }
+            }
+        }
+
+        if (oid != NO_INDEX) {
+            for (const auto& p : old.kvs_of(oid)) {
+                if (old.find(oid, p.key) != &p)
+                    continue;
+                if (nid == NO_INDEX || doc.find(nid, p.key) == nullptr) {
+                    d.changes.push_back(
+                        { CHANGE::REMOVED, path, p.key, &p, nullptr });
+                }
+            }
+        }
+    }
+
+    std::string path_;
+    parse_options opts_;
+    file_watcher watcher_;
+    std::vector<reload::block> blocks_;  // of the latest version
+    document_store store_;
+    std::vector<subscriber> subscribers_;
+};
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <expected>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "util.hpp"
+#include "hash_index.hpp"
+#include "confparse.hpp"
+
+// binds a config straight to a struct, without building a document. a
+// struct is given a schema by specializing schema<S> with a constexpr tuple
+// of fields, one per member:
+//
+//     template<> struct schema<server_config> {
+//         static constexpr std::tuple fields = {
+//             bind_field("name", &server_config::name, "srv"),
+//             bind_field("net.port", &server_config::port, 8080, 1, 65535),
+//             bind_field("net.tls", &server_config::tls, true)
+//         };
+//     };
+//
+// a field's path is the dotted path of its section followed by its key, so
+// keys containing dots cannot be bound. each field holds bool, an integer,
+// a floating point type, std::string or std::string_view, which decides
+// the KV_PAIR_VALUE it accepts; conversions are those of kv::value_as().
+template<typename S>
+struct schema;
+
+// one member of S bound to the kv at path. values of arithmetic fields
+// outside [min, max] are rejected. std::string members are given their
+// fallback as a view, so that a schema stays a literal type.
+template<typename S, typename T>
+struct field {
+    using struct_type = S;
+    using value_type = T;
+    using const_type = std::conditional_t<std::same_as<T, std::string>,
+                                          std::string_view,
+                                          T>;
+
+    std::string_view path;
+    T S::* member = nullptr;
+    const_type fallback{};  // what the member holds if its kv is missing
+    const_type min = std::numeric_limits<const_type>::lowest();
+    const_type max = std::numeric_limits<const_type>::max();
+
+    static constexpr bool HAS_RANGE =
+        std::is_arithmetic_v<T> && !std::same_as<T, bool>;
+
+    static constexpr KV_PAIR_VALUE TYPE = [] {
+        if constexpr (std::same_as<T, bool>)
+            return KV_PAIR_VALUE::BOOL;
+        else if constexpr (std::signed_integral<T>)
+            return KV_PAIR_VALUE::INT;
+        else if constexpr (std::unsigned_integral<T>)
+            return KV_PAIR_VALUE::UINT;
+        else if constexpr (std::floating_point<T>)
+            return KV_PAIR_VALUE::FLOAT;
+        else
+            return KV_PAIR_VALUE::STRING;
+    }();
+
+    static_assert(std::is_arithmetic_v<T> ||
+                  std::same_as<T, std::string> ||
+                  std::same_as<T, std::string_view>,
+                  "field: unsupported member type.");
+
+    NO_DISCARD constexpr std::string_view section() const noexcept {
+        const std::size_t dot = path.rfind('.');
+        return dot == std::string_view::npos ? "" : path.substr(0, dot);
+    }
+
+    NO_DISCARD constexpr std::string_view key() const noexcept {
+        const std::size_t dot = path.rfind('.');
+        return dot == std::string_view::npos ? path : path.substr(dot + 1);
+    }
+};
+
+template<typename S, typename T>
+NO_DISCARD constexpr field<S, T>
+bind_field(std::string_view path, 
+           T S::* member, 
+           typename field<S, T>::const_type fallback = {}) {
+    return { path, member, fallback };
+}
+
+template<typename S, typename T>
+NO_DISCARD constexpr field<S, T>
+bind_field(std::string_view path,
+           T S::* member,
+           typename field<S, T>::const_type fallback,
+           typename field<S, T>::const_type min,
+           typename field<S, T>::const_type max) {
+    return { path, member, fallback, min, max };
+}
+
+// a field whose value was rejected. the member keeps what it held before.
+struct bind_error {
+    std::string_view path;
+    LOOKUP_ERROR code;
+};
+
+struct bind_result {
+    std::size_t bound = 0;          // kvs stored into a member
+    std::size_t unknown = 0;        // kvs no field is bound to
+    std::size_t invalid_lines = 0;  // lines that could not be parsed
+    std::vector<bind_error> errors;
+
+    NO_DISCARD bool ok() const noexcept {
+        return invalid_lines == 0 && errors.empty();
+    }
+};
+
+namespace schema_detail {
+
+// a minimal perfect hash over the paths of S's fields: the hash of a key,
+// seeded with the hash of its section, picks one slot of a table twice the
+// size of the schema, and the seed is searched for at compile time so that
+// no two fields share a slot
+template<typename S>
+struct table {
+    static constexpr auto& FIELDS = schema<S>::fields;
+    static constexpr std::size_t N =
+        std::tuple_size_v<std::remove_cvref_t<decltype(FIELDS)>>;
+    static constexpr std::size_t SIZE = std::bit_ceil(2 * N + 1);
+    static constexpr std::uint16_t NONE = 0xffff;
+
+    static_assert(N > 0 && N < NONE, "schema: too many or too few fields.");
+
+    std::uint64_t seed = 0;
+    std::array<std::uint16_t, SIZE> slots{};
+    std::array<std::string_view, N> sections{};
+    std::array<std::string_view, N> keys{};
+
+    NO_DISCARD static constexpr std::size_t
+    slot_of(std::uint64_t key_hash, std::uint64_t seed) noexcept {
+        return util::hash_int(key_hash ^ seed) & (SIZE - 1);
+    }
+
+    NO_DISCARD static consteval table make() {
+        table t;
+        std::apply([&](const auto&... f) {
+            t.sections = { f.section()... };
+            t.keys = { f.key()... };
+        }, FIELDS);
+
+        std::array<std::uint64_t, N> hashes{};
+        for (std::size_t i = 0; i < N; ++i) {
+            hashes[i] = util::hash_bytes(t.keys[i],
+                                         util::hash_bytes(t.sections[i]));
+            for (std::size_t j = 0; j < i; ++j) {
+                if (t.sections[i] == t.sections[j] && t.keys[i] == t.keys[j])
+                    throw "schema: two fields are bound to the same path.";
+            }
+        }
+
+        for (std::uint64_t seed = 0; seed < (1U << 16); ++seed) {
+            t.seed = util::hash_int(seed + 1);
+            t.slots.fill(NONE);
+            bool perfect = true;
+            for (std::size_t i = 0; i < N && perfect; ++i) {
+                std::uint16_t& s = t.slots[slot_of(hashes[i], t.seed)];
+                perfect = s == NONE;
+                s = static_cast<std::uint16_t>(i);
+            }
+            if (perfect)
+                return t;
+        }
+        throw "schema: no perfect hash found.";
+    }
+};
+
+template<typename S>
+inline constexpr table<S> TABLE = table<S>::make();
+
+// converts v and stores it into f's member of out, checking its range
+template<typename F>
+NO_DISCARD constexpr std::expected<void, LOOKUP_ERROR>
+store(const F& f, typename F::struct_type& out, const kv::value_ref& v) {
+    const auto x = v.as<typename F::const_type>();
+    if (!x)
+        return std::unexpected(x.error());
+    if constexpr (F::HAS_RANGE) {
+        if (*x < f.min || *x > f.max)
+            return std::unexpected(LOOKUP_ERROR::OUT_OF_RANGE);
+    }
+    out.*f.member = *x;
+    return {};
+}
+
+} // namespace schema_detail
+
+// a parse_handler that stores kvs straight into the members of out. each
+// kv costs one hash of its key and one probe of a table built at compile
+// time; values are parsed lazily, so those of unknown keys are never
+// converted. members start out holding their fallbacks.
+template<typename S>
+class schema_binder {
+    using table = schema_detail::table<S>;
+
+public:
+    explicit schema_binder(S& out, diagnostics* d = nullptr)
+        : out_(out),
+          diagnostics_(d)
+    {
+        std::apply([&](const auto&... f) {
+            ((out_.*f.member = f.fallback), ...);
+        }, table::FIELDS);
+    }
+
+    void on_section(std::string_view path) noexcept {
+        section_ = path;
+        section_hash_ = util::hash_bytes(path);
+    }
+
+    void on_kv(std::string_view key, const kv::value_ref& v) {
+        constexpr const table& t = schema_detail::TABLE<S>;
+        const std::uint64_t h = util::hash_bytes(key, section_hash_);
+        const std::uint16_t i = t.slots[table::slot_of(h, t.seed)];
+        if (i == table::NONE || t.keys[i] != key || t.sections[i] != section_) {
+            ++result_.unknown;
+            return;
+        }
+        if (const auto r = SETTERS[i](out_, v); !r)
+            result_.errors.push_back({ PATHS[i], r.error() });
+        else
+            ++result_.bound;
+    }
+
+    bool on_error(const diagnostic& d) noexcept {
+        ++result_.invalid_lines;
+        return diagnostics_ == nullptr || diagnostics_->report(d);
+    }
+
+    NO_DISCARD bind_result& result() noexcept { return result_; }
+
+private:
+    using setter = std::expected<void, LOOKUP_ERROR> (*)(S&, const kv::value_ref&);
+
+    template<std::size_t... I>
+    static constexpr std::array<setter, table::N>
+    make_setters(std::index_sequence<I...>) noexcept {
+        return { +[](S& out, const kv::value_ref& v) {
+            return schema_detail::store(std::get<I>(table::FIELDS), out, v);
+        }... };
+    }
+
+    static constexpr std::array<setter, table::N> SETTERS =
+        make_setters(std::make_index_sequence<table::N>{});
+
+    static constexpr std::array<std::string_view, table::N> PATHS =
+        std::apply([](const auto&... f) {
+            return std::array<std::string_view, table::N>{ f.path... };
+        }, table::FIELDS);
+
+    S& out_;
+    diagnostics* diagnostics_;
+    std::string_view section_;
+    std::uint64_t section_hash_ = util::hash_bytes("");
+    bind_result result_;
+};
+
+// fills out from buf. string_view members refer to buf. invalid lines are
+// skipped, or reported to d, whose policy may stop the parse.
+template<typename S>
+NO_DISCARD bind_result
+parse_into(std::string_view buf, S& out, diagnostics* d = nullptr) {
+    schema_binder<S> b(out, d);
+    line_scanner sc(buf);
+    parse_lines(sc, b, true);
+    return std::move(b.result());
+}
+
+// as parse_into(), from a file that is unmapped on return, so S cannot
+// hold views
+template<typename S>
+NO_DISCARD bind_result
+parse_file_into(std::string_view path, S& out, diagnostics* d = nullptr) {
+    static_assert(std::apply([](const auto&... f) {
+        return (!std::same_as<typename std::remove_cvref_t<decltype(f)>::value_type,
+                              std::string_view> && ...);
+    }, schema<S>::fields), "parse_file_into(): string_view members would dangle.");
+    const file_buffer f = load_file(path);
+    return parse_into(f.view(), out, d);
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "util.hpp"
+#include "confparse.hpp"
+
+// publishes documents to concurrent readers as immutable versions.
+//
+// readers never lock: a read announces the current epoch in the reader's
+// own slot and loads the current version, which stays alive until the
+// snapshot is dropped. a writer swaps in a new version, advances the epoch
+// and retires the old one, which is freed once no reader slot holds an
+// epoch at or before its retirement. this is epoch-based reclamation; a
+// read costs two loads and a store, whatever the writers are doing.
+class document_store {
+    struct node;
+
+public:
+    using self_type = document_store;
+
+    static constexpr std::size_t MAX_READERS = 256;
+
+    class reader;
+
+    // keeps one version alive and readable
+    class snapshot {
+    public:
+        snapshot(snapshot&& o) noexcept
+            : r_(std::exchange(o.r_, nullptr)),
+              v_(o.v_)
+        {
+
+        }
+
+        snapshot(const snapshot&) = delete;
+        snapshot& operator=(const snapshot&) = delete;
+        snapshot& operator=(snapshot&&) = delete;
+
+        ~snapshot() {
+            if (r_ != nullptr)
+                r_->leave();
+        }
+
+        NO_DISCARD const document& operator*() const noexcept { return v_->doc; }
+        NO_DISCARD const document* operator->() const noexcept { return &v_->doc; }
+
+        // 1 for the first document published, counting up from there
+        NO_DISCARD std::uint64_t version() const noexcept { return v_->number; }
+
+    private:
+        friend class reader;
+
+        snapshot(reader* r, const node* v) noexcept : r_(r), v_(v) { }
+
+        reader* r_;
+        const node* v_;
+    };
+
+    // a thread's registration with the store. a reader is used by one
+    // thread at a time, and must not be moved while it has snapshots out;
+    // each thread that reads should register its own.
+    class reader {
+    public:
+        reader(reader&& o) noexcept
+            : store_(std::exchange(o.store_, nullptr)),
+              slot_(o.slot_),
+              depth_(o.depth_)
+        {
+
+        }
+
+        reader(const reader&) = delete;
+        reader& operator=(const reader&) = delete;
+        reader& operator=(reader&&) = delete;
+
+        // all snapshots taken through the reader must be gone by now
+        ~reader() {
+            if (store_ != nullptr)
+                store_->slots_[slot_].claimed.store(false, std::memory_order_release);
+        }
+
+        // snapshots may nest; the outermost one keeps the epoch announced
+        NO_DISCARD snapshot read() noexcept {
+            if (depth_++ == 0) {
+                store_->slots_[slot_].epoch.store(
+                    store_->epoch_.load(std::memory_order_seq_cst),
+                    std::memory_order_seq_cst);
+            }
+            return { this, store_->current_.load(std::memory_order_seq_cst) };
+        }
+
+    private:
+        friend class document_store;
+
+        reader(document_store* s, std::size_t slot) noexcept
+            : store_(s),
+              slot_(slot)
+        {
+
+        }
+
+        void leave() noexcept {
+            if (--depth_ == 0)
+                store_->slots_[slot_].epoch.store(0, std::memory_order_release);
+        }
+
+        document_store* store_;
+        std::size_t slot_;
+        std::uint32_t depth_ = 0;
+    };
+
+    explicit document_store(document doc)
+        : current_(new node{ std::move(doc), 1 })
+    {
+
+    }
+
+    document_store(const self_type&) = delete;
+    self_type& operator=(const self_type&) = delete;
+
+    // every reader must be gone by now
+    ~document_store() {
+        delete current_.load(std::memory_order_relaxed);
+    }
+
+    // throws std::length_error if MAX_READERS readers are registered
+    NO_DISCARD reader register_reader() {
+        for (std::size_t i = 0; i < slots_.size(); ++i) {
+            bool claimed = false;
+            if (slots_[i].claimed.compare_exchange_strong(
+                    claimed, true, std::memory_order_acq_rel))
+                return reader(this, i);
+        }
+        throw std::length_error("too many readers.");
+    }
+
+    // makes next the version new snapshots see. the previous version is
+    // freed here or by a later publish() or reclaim() once no snapshot of
+    // it remains. publishers are serialized; readers are never blocked.
+    void publish(document next) {
+        const std::lock_guard lock(writer_);
+        auto* n = new node{
+            std::move(next),
+            current_.load(std::memory_order_relaxed)->number + 1
+        };
+        const node* old = current_.exchange(n, std::memory_order_seq_cst);
+        const std::uint64_t e = epoch_.fetch_add(1, std::memory_order_seq_cst);
+        retired_.emplace_back(old, e);
+        reclaim_locked();
+    }
+
+    // frees the retired versions that no snapshot can still see, and
+    // returns how many are left
+    std::size_t reclaim() {
+        const std::lock_guard lock(writer_);
+        reclaim_locked();
+        return retired_.size();
+    }
+
+    // the current version, without a snapshot. only safe on the thread that
+    // publishes, since nothing else retires it.
+    NO_DISCARD const document& latest() const noexcept {
+        return current_.load(std::memory_order_acquire)->doc;
+    }
+
+    NO_DISCARD std::uint64_t version() const noexcept {
+        return current_.load(std::memory_order_acquire)->number;
+    }
+
+private:
+    struct node {
+        document doc;
+        std::uint64_t number;
+    };
+
+    // a cache line each, so readers do not contend on each other's slots
+    struct alignas(64) slot {
+        std::atomic<std::uint64_t> epoch = 0;  // 0 while not reading
+        std::atomic<bool> claimed = false;
+    };
+
+    void reclaim_locked() {
+        std::uint64_t oldest = UINT64_MAX;
+        for (const auto& s : slots_) {
+            const std::uint64_t e = s.epoch.load(std::memory_order_seq_cst);
+            if (e != 0)
+                oldest = std::min(oldest, e);
+        }
+
+        // a reader that announced an epoch after a version was retired
+        // loaded its successor or something newer
+        std::erase_if(retired_, [&](const auto& r) { return r.second < oldest; });
+    }
+
+    std::atomic<const node*> current_;
+    std::atomic<std::uint64_t> epoch_ = 1;
+    std::array<slot, MAX_READERS> slots_;
+    std::mutex writer_;
+    // retired versions, with the epoch that was current when they went
+    std::vector<std::pair<std::unique_ptr<const node>, std::uint64_t>> retired_;
+};
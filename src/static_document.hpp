@@ -0,0 +1,318 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <expected>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "util.hpp"
+#include "structural.hpp"
+#include "confparse.hpp"
+
+// configs known at compile time, such as built-in defaults, parsed in
+// constant evaluation into tables that live in the binary:
+//
+//     constexpr auto defaults = parse_static<R"(
+//         name = server
+//         [net]
+//         port = 8080
+//     )">();
+//     static_assert(defaults.get<int>("net.port") == 8080);
+//
+// parsing costs nothing at run time, and an invalid line is a compile
+// error. values convert as they would at run time, except that arrays are
+// not supported and floats only convert where that is exact; see
+// constant::parse_float(). the text may also be a char array, such as one
+// filled in by #embed: parse_static<fixed_string(text)>().
+
+// a converted value. strings are views of the config text.
+struct static_value {
+    KV_PAIR_VALUE type = KV_PAIR_VALUE::ERR;
+    union {
+        bool b;
+        std::intmax_t i;
+        std::size_t u;
+        kv::float_type f = 0;
+    };
+    std::string_view s;
+
+    // converts to T as kv::value_as() does
+    template<typename T>
+    NO_DISCARD constexpr std::expected<T, LOOKUP_ERROR> as() const noexcept {
+        if constexpr (std::same_as<T, bool>) {
+            if (type == KV_PAIR_VALUE::BOOL)
+                return b;
+        } else if constexpr (std::integral<T>) {
+            if (type == KV_PAIR_VALUE::UINT || type == KV_PAIR_VALUE::INT) {
+                const bool fits = type == KV_PAIR_VALUE::UINT ?
+                    std::in_range<T>(u) :
+                    std::in_range<T>(i);
+                if (!fits)
+                    return std::unexpected(LOOKUP_ERROR::OUT_OF_RANGE);
+                return type == KV_PAIR_VALUE::UINT ?
+                    static_cast<T>(u) :
+                    static_cast<T>(i);
+            }
+        } else if constexpr (std::floating_point<T>) {
+            if (type == KV_PAIR_VALUE::FLOAT)
+                return static_cast<T>(f);
+            if (type == KV_PAIR_VALUE::UINT)
+                return static_cast<T>(u);
+            if (type == KV_PAIR_VALUE::INT)
+                return static_cast<T>(i);
+        } else {
+            static_assert(std::same_as<T, std::string_view>,
+                          "static_value::as(): unsupported type.");
+            if (type == KV_PAIR_VALUE::STRING)
+                return s;
+        }
+        return std::unexpected(LOOKUP_ERROR::WRONG_TYPE);
+    }
+};
+
+struct static_kv {
+    std::string_view key;
+    static_value value;
+};
+
+struct static_section {
+    std::string_view path;
+    // this section's kvs are static_document::kvs[first_kv, first_kv + kv_count)
+    std::uint32_t first_kv = 0;
+    std::uint32_t kv_count = 0;
+};
+
+// sections are sorted by path, so the global section comes first, and each
+// section's kvs by key, so that both are found by binary search. a key
+// that appears more than once in a section keeps its last value, and
+// ancestors of a section are present as in a document.
+template<std::size_t SECTIONS, std::size_t KVS>
+struct static_document {
+    std::array<static_section, SECTIONS> sections{};
+    std::array<static_kv, KVS> kvs{};
+
+    NO_DISCARD constexpr const static_section& global() const noexcept {
+        return sections[0];
+    }
+
+    // returns the id of the section with the given dotted path ("" for the
+    // global section), or NO_INDEX
+    NO_DISCARD constexpr section_id
+    find_section(std::string_view path) const noexcept {
+        const auto it = std::lower_bound(
+            sections.begin(), sections.end(), path,
+            [](const static_section& s, std::string_view p) {
+                return s.path < p;
+            });
+        return it == sections.end() || it->path != path ?
+            NO_INDEX :
+            static_cast<section_id>(it - sections.begin());
+    }
+
+    NO_DISCARD constexpr const static_kv*
+    find(section_id id, std::string_view key) const noexcept {
+        const auto first = kvs.begin() + sections[id].first_kv;
+        const auto last = first + sections[id].kv_count;
+        const auto it = std::lower_bound(
+            first, last, key,
+            [](const static_kv& p, std::string_view k) { return p.key < k; });
+        return it == last || it->key != key ? nullptr : &*it;
+    }
+
+    // looks up "section.sub.key", or "key" in the global section
+    NO_DISCARD constexpr const static_kv*
+    find(std::string_view path) const noexcept {
+        const std::size_t dot = path.rfind('.');
+        if (dot == std::string_view::npos)
+            return find(0, path);
+
+        const section_id id = find_section(path.substr(0, dot));
+        return id == NO_INDEX ? nullptr : find(id, path.substr(dot + 1));
+    }
+
+    template<typename T>
+    NO_DISCARD constexpr std::expected<T, LOOKUP_ERROR>
+    get(section_id id, std::string_view key) const noexcept {
+        const static_kv* p = find(id, key);
+        if (p == nullptr)
+            return std::unexpected(LOOKUP_ERROR::NO_SUCH_KEY);
+        return p->value.template as<T>();
+    }
+
+    // typed lookup of "section.sub.key", or "key" in the global section
+    template<typename T>
+    NO_DISCARD constexpr std::expected<T, LOOKUP_ERROR>
+    get(std::string_view path) const noexcept {
+        const std::size_t dot = path.rfind('.');
+        if (dot == std::string_view::npos)
+            return get<T>(0, path);
+
+        const section_id id = find_section(path.substr(0, dot));
+        if (id == NO_INDEX)
+            return std::unexpected(LOOKUP_ERROR::NO_SUCH_SECTION);
+        return get<T>(id, path.substr(dot + 1));
+    }
+};
+
+// config text as a template argument. a trailing NUL, as string literals
+// have, is not part of the text.
+template<std::size_t N>
+struct fixed_string {
+    char chars[N] = {};
+
+    consteval fixed_string(const char (&s)[N]) {
+        std::copy_n(s, N, chars);
+    }
+
+    NO_DISCARD constexpr std::string_view view() const noexcept {
+        return { chars, N > 0 && chars[N - 1] == '\0' ? N - 1 : N };
+    }
+};
+
+namespace static_detail {
+
+struct entry {
+    std::string_view section;
+    static_kv kv;
+};
+
+struct table {
+    std::vector<std::string_view> sections;
+    std::vector<entry> kvs;
+};
+
+constexpr static_value convert(std::string_view raw) {
+    if (raw.front() == '[')
+        throw "parse_static(): arrays are not supported.";
+
+    // the scanner has already matched the quotes of a quoted value
+    value_class c;
+    if (raw.front() == '"') {
+        c.type = KV_PAIR_VALUE::STRING;
+        c.digits = raw.substr(1, raw.size() - 2);
+    } else {
+        c = classify_value(raw);
+    }
+
+    static_value v;
+    v.type = c.type;
+    PARSE_ERROR e = PARSE_ERROR::NONE;
+    switch (c.type) {
+    case KV_PAIR_VALUE::BOOL:
+        v.b = parse_kv_value_as_bool(c);
+        break;
+    // the union's members are assigned, as constant evaluation only lets
+    // an assignment change which one is active
+    case KV_PAIR_VALUE::INT: {
+        std::intmax_t i = 0;
+        e = parse_kv_value_as_signed_int(c, i);
+        v.i = i;
+        break;
+    }
+    case KV_PAIR_VALUE::UINT: {
+        std::size_t u = 0;
+        e = parse_kv_value_as_unsigned_int(c, u);
+        v.u = u;
+        break;
+    }
+    case KV_PAIR_VALUE::FLOAT: {
+        kv::float_type f = 0;
+        e = parse_kv_value_as_float(c, f);
+        v.f = f;
+        break;
+    }
+    case KV_PAIR_VALUE::STRING:
+        v.s = parse_kv_value_as_string(c);
+        break;
+    default:
+        e = PARSE_ERROR::INVALID_VALUE;
+        break;
+    }
+    if (e == PARSE_ERROR::OUT_OF_RANGE)
+        throw "parse_static(): value out of range.";
+    if (ERROR(e))
+        throw "parse_static(): invalid value, or a float that is not exact.";
+    return v;
+}
+
+constexpr void add_section(table& t, std::string_view path) {
+    // ancestors first, as a document opens them
+    for (std::size_t dot = path.find('.'); dot != std::string_view::npos;
+         dot = path.find('.', dot + 1))
+        add_section(t, path.substr(0, dot));
+    if (std::find(t.sections.begin(), t.sections.end(), path) ==
+        t.sections.end())
+        t.sections.push_back(path);
+}
+
+constexpr table build(std::string_view text) {
+    table t;
+    t.sections.push_back("");
+    std::string_view current;
+
+    line_scanner sc(text);
+    for (line_tokens l; sc.next(l); ) {
+        if (l.begin == l.end)
+            continue;
+
+        if (text[l.begin] == '[') {
+            if (ERROR(parse_section_header(
+                    text.substr(l.begin, l.end - l.begin), current)))
+                throw "parse_static(): invalid section header.";
+            add_section(t, current);
+            continue;
+        }
+
+        std::string_view key, raw;
+        if (ERROR(tokenize_kv(sc, l, key, raw)))
+            throw "parse_static(): a line is not a valid key = value.";
+        const static_value v = convert(raw);
+
+        const auto it = std::find_if(t.kvs.begin(), t.kvs.end(),
+            [&](const entry& e) {
+                return e.section == current && e.kv.key == key;
+            });
+        if (it != t.kvs.end())
+            it->kv.value = v;
+        else
+            t.kvs.push_back({ current, { key, v } });
+    }
+
+    std::sort(t.sections.begin(), t.sections.end());
+    std::sort(t.kvs.begin(), t.kvs.end(), [](const entry& a, const entry& b) {
+        return a.section != b.section ?
+            a.section < b.section :
+            a.kv.key < b.kv.key;
+    });
+    return t;
+}
+
+} // namespace static_detail
+
+// parses Text at compile time; an invalid line fails compilation
+template<fixed_string Text>
+NO_DISCARD consteval auto parse_static() {
+    constexpr std::pair<std::size_t, std::size_t> size = [] {
+        const static_detail::table t = static_detail::build(Text.view());
+        return std::pair(t.sections.size(), t.kvs.size());
+    }();
+
+    const static_detail::table t = static_detail::build(Text.view());
+    static_document<size.first, size.second> doc;
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < size.first; ++i) {
+        static_section& s = doc.sections[i];
+        s.path = t.sections[i];
+        s.first_kv = static_cast<std::uint32_t>(k);
+        for (; k < size.second && t.kvs[k].section == s.path; ++k)
+            doc.kvs[k] = t.kvs[k].kv;
+        s.kv_count = static_cast<std::uint32_t>(k) - s.first_kv;
+    }
+    return doc;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+
+#include <algorithm>
+#include <chrono>
+#include <memory_resource>
+
+#include "util.hpp"
+
+// parse statistics are only collected if CONFPARSE_STATS is defined;
+// otherwise everything that gathers them compiles away
+#ifdef CONFPARSE_STATS
+inline constexpr bool STATS_ENABLED = true;
+#else
+inline constexpr bool STATS_ENABLED = false;
+#endif
+
+namespace util {
+
+// the time between laps, or nothing at all if stats are compiled out
+class phase_timer {
+public:
+    using clock = std::chrono::steady_clock;
+
+    phase_timer() noexcept {
+        if constexpr (STATS_ENABLED)
+            last_ = clock::now();
+    }
+
+    // the time since construction or the previous lap
+    std::chrono::nanoseconds lap() noexcept {
+        if constexpr (STATS_ENABLED) {
+            const clock::time_point now = clock::now();
+            const auto d = now - last_;
+            last_ = now;
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(d);
+        } else {
+            return {};
+        }
+    }
+
+private:
+    clock::time_point last_{};
+};
+
+// forwards to an upstream resource, counting what passes through. not
+// thread-safe, like the monotonic arenas it is meant to sit under.
+class counting_resource : public std::pmr::memory_resource {
+public:
+    explicit counting_resource(
+        std::pmr::memory_resource* upstream = std::pmr::get_default_resource())
+        : upstream_(upstream)
+    {
+
+    }
+
+    NO_DISCARD std::size_t allocations() const noexcept { return allocations_; }
+    NO_DISCARD std::size_t allocated() const noexcept { return allocated_; }
+    NO_DISCARD std::size_t in_use() const noexcept { return in_use_; }
+    NO_DISCARD std::size_t peak() const noexcept { return peak_; }
+
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override {
+        void* p = upstream_->allocate(bytes, align);
+        ++allocations_;
+        allocated_ += bytes;
+        in_use_ += bytes;
+        peak_ = std::max(peak_, in_use_);
+        return p;
+    }
+
+    void do_deallocate(void* p, std::size_t bytes, std::size_t align) override {
+        upstream_->deallocate(p, bytes, align);
+        in_use_ -= bytes;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override {
+        return this == &o;
+    }
+
+    std::pmr::memory_resource* upstream_;
+    std::size_t allocations_ = 0;
+    std::size_t allocated_ = 0;
+    std::size_t in_use_ = 0;
+    std::size_t peak_ = 0;
+};
+
+} // namespace util
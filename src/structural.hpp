@@ -0,0 +1,389 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <bit>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#if defined __AVX2__
+#   define HAS_AVX2 1
+#   include <immintrin.h>
+#elif defined __SSE2__ || defined _M_X64
+#   define HAS_SSE2 1
+#   include <emmintrin.h>
+#elif defined __ARM_NEON && defined __aarch64__
+#   define HAS_NEON 1
+#   include <arm_neon.h>
+#endif
+
+#include "util.hpp"
+
+// stage 1 of the parser sweeps the buffer 64 bytes at a time and marks the
+// characters later stages care about. stage 2 then walks only those marks to
+// find each line's comment, '=' and quotes, instead of re-searching the line
+// once per predicate.
+
+// one bit per byte of a 64-byte block
+struct block_masks {
+    std::uint64_t structural = 0;   // \n = [ ] # ; " and backslash
+    std::uint64_t whitespace = 0;   // space, tab and carriage return
+};
+
+NO_DISCARD constexpr bool CHAR_IS_STRUCTURAL(char c) noexcept {
+    return c == '\n' || c == '=' || c == '[' || c == ']' || c == '#' ||
+           c == ';' || c == '"' || c == '\\';
+}
+
+NO_DISCARD constexpr bool CHAR_IS_WHITESPACE(char c) noexcept {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+// portable fallback, also used for the final partial block
+NO_DISCARD constexpr block_masks
+classify_block_scalar(const char* p, std::size_t n) noexcept {
+    block_masks m;
+    for (std::size_t i = 0; i < n && i < 64; ++i) {
+        m.structural |= static_cast<std::uint64_t>(CHAR_IS_STRUCTURAL(p[i])) << i;
+        m.whitespace |= static_cast<std::uint64_t>(CHAR_IS_WHITESPACE(p[i])) << i;
+    }
+    return m;
+}
+
+#if defined HAS_AVX2
+inline block_masks classify_block_simd(const char* p) noexcept {
+    auto classify = [](const char* q, std::uint64_t& s, std::uint64_t& w) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(q));
+        auto eq = [&](char c) {
+            return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+        };
+        const __m256i st = _mm256_or_si256(
+            _mm256_or_si256(_mm256_or_si256(eq('\n'), eq('=')),
+                            _mm256_or_si256(eq('['), eq(']'))),
+            _mm256_or_si256(_mm256_or_si256(eq('#'), eq(';')),
+                            _mm256_or_si256(eq('"'), eq('\\'))));
+        const __m256i ws =
+            _mm256_or_si256(_mm256_or_si256(eq(' '), eq('\t')), eq('\r'));
+        s = static_cast<std::uint32_t>(_mm256_movemask_epi8(st));
+        w = static_cast<std::uint32_t>(_mm256_movemask_epi8(ws));
+    };
+
+    std::uint64_t s0, w0, s1, w1;
+    classify(p, s0, w0);
+    classify(p + 32, s1, w1);
+    return { s0 | (s1 << 32), w0 | (w1 << 32) };
+}
+#elif defined HAS_SSE2
+inline block_masks classify_block_simd(const char* p) noexcept {
+    block_masks m;
+    for (int i = 0; i < 4; ++i) {
+        const __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+        auto eq = [&](char c) { return _mm_cmpeq_epi8(v, _mm_set1_epi8(c)); };
+        const __m128i st = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(eq('\n'), eq('=')),
+                         _mm_or_si128(eq('['), eq(']'))),
+            _mm_or_si128(_mm_or_si128(eq('#'), eq(';')),
+                         _mm_or_si128(eq('"'), eq('\\'))));
+        const __m128i ws = _mm_or_si128(_mm_or_si128(eq(' '), eq('\t')),
+                                        eq('\r'));
+        const auto s = static_cast<std::uint16_t>(_mm_movemask_epi8(st));
+        const auto w = static_cast<std::uint16_t>(_mm_movemask_epi8(ws));
+        m.structural |= static_cast<std::uint64_t>(s) << (16 * i);
+        m.whitespace |= static_cast<std::uint64_t>(w) << (16 * i);
+    }
+    return m;
+}
+#elif defined HAS_NEON
+inline block_masks classify_block_simd(const char* p) noexcept {
+    // narrows four 0x00/0xff byte vectors to one bit per byte
+    auto to_bitmask = [](uint8x16_t v0, uint8x16_t v1,
+                         uint8x16_t v2, uint8x16_t v3) {
+        const uint8x16_t bits = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+                                  0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80 };
+        uint8x16_t sum0 = vpaddq_u8(vandq_u8(v0, bits), vandq_u8(v1, bits));
+        uint8x16_t sum1 = vpaddq_u8(vandq_u8(v2, bits), vandq_u8(v3, bits));
+        sum0 = vpaddq_u8(sum0, sum1);
+        sum0 = vpaddq_u8(sum0, sum0);
+        return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+    };
+
+    uint8x16_t st[4], ws[4];
+    for (int i = 0; i < 4; ++i) {
+        const uint8x16_t v =
+            vld1q_u8(reinterpret_cast<const std::uint8_t*>(p + 16 * i));
+        auto eq = [&](char c) {
+            return vceqq_u8(v, vdupq_n_u8(static_cast<std::uint8_t>(c)));
+        };
+        st[i] = vorrq_u8(vorrq_u8(vorrq_u8(eq('\n'), eq('=')),
+                                  vorrq_u8(eq('['), eq(']'))),
+                         vorrq_u8(vorrq_u8(eq('#'), eq(';')),
+                                  vorrq_u8(eq('"'), eq('\\'))));
+        ws[i] = vorrq_u8(vorrq_u8(eq(' '), eq('\t')), eq('\r'));
+    }
+    return { to_bitmask(st[0], st[1], st[2], st[3]),
+             to_bitmask(ws[0], ws[1], ws[2], ws[3]) };
+}
+#endif
+
+// stage 1 output for buf[base, base + size)
+struct structural_masks {
+    std::vector<std::uint64_t> structural;
+    std::vector<std::uint64_t> whitespace;
+    std::size_t base = 0;
+    std::size_t size = 0;
+};
+
+// classifies buf[begin, end) into m, reusing m's storage. with force_scalar,
+// or in constant evaluation, the portable path is used even where SIMD is 
+// available.
+constexpr void scan_structurals(std::string_view buf,
+                             std::size_t begin,
+                             std::size_t end,
+                             structural_masks& m,
+                             bool force_scalar = false) {
+    const std::size_t n = end - begin;
+    const std::size_t blocks = (n + 63) / 64;
+    m.structural.resize(blocks);
+    m.whitespace.resize(blocks);
+    m.base = begin;
+    m.size = n;
+
+    const char* p = buf.data() + begin;
+    std::size_t b = 0;
+#if defined HAS_AVX2 || defined HAS_SSE2 || defined HAS_NEON
+    if (!force_scalar && !std::is_constant_evaluated()) {
+        for (; b < n / 64; ++b) {
+            const block_masks bm = classify_block_simd(p + 64 * b);
+            m.structural[b] = bm.structural;
+            m.whitespace[b] = bm.whitespace;
+        }
+    }
+#endif
+    for (; b < blocks; ++b) {
+        const block_masks bm = classify_block_scalar(p + 64 * b, n - 64 * b);
+        m.structural[b] = bm.structural;
+        m.whitespace[b] = bm.whitespace;
+    }
+}
+
+namespace bits {
+
+inline constexpr std::size_t npos = std::string_view::npos;
+
+// first set bit of mask at a position in [from, to), or npos. positions are
+// relative to the start of mask.
+NO_DISCARD constexpr std::size_t
+next_set(const std::uint64_t* mask, std::size_t from, std::size_t to,
+         bool invert = false) noexcept {
+    if (from >= to)
+        return npos;
+
+    const std::uint64_t flip = invert ? ~0ULL : 0ULL;
+    std::size_t w = from / 64;
+    std::uint64_t word = (mask[w] ^ flip) & (~0ULL << (from % 64));
+    for (;;) {
+        if (word != 0) {
+            const std::size_t i = w * 64 +
+                static_cast<std::size_t>(std::countr_zero(word));
+            return i < to ? i : npos;
+        }
+        if (++w * 64 >= to)
+            return npos;
+        word = mask[w] ^ flip;
+    }
+}
+
+// last set bit of mask at a position in [from, to), or npos
+NO_DISCARD constexpr std::size_t
+prev_set(const std::uint64_t* mask, std::size_t from, std::size_t to,
+         bool invert = false) noexcept {
+    if (from >= to)
+        return npos;
+
+    const std::uint64_t flip = invert ? ~0ULL : 0ULL;
+    std::size_t w = (to - 1) / 64;
+    std::uint64_t word = (mask[w] ^ flip) & (~0ULL >> (63 - (to - 1) % 64));
+    for (;;) {
+        if (word != 0) {
+            const std::size_t i = w * 64 + 63 -
+                static_cast<std::size_t>(std::countl_zero(word));
+            return i >= from ? i : npos;
+        }
+        if (w-- * 64 <= from)
+            return npos;
+        word = mask[w] ^ flip;
+    }
+}
+
+} // namespace bits
+
+// positions stage 2 found in one line, as offsets into the buffer
+struct line_tokens {
+    std::size_t line_begin = 0;         // first byte of the line
+    std::size_t begin = 0;              // first non-whitespace content byte
+    std::size_t end = 0;                // one past the last; comment excluded
+    std::size_t eq = bits::npos;        // first '=' outside quotes
+    std::size_t quote_open = bits::npos;  // the '"' beginning the value
+    std::size_t quote_close = bits::npos; // the unescaped '"' closing it
+    std::size_t number = 0;             // 1-based line number
+};
+
+// stage 2: splits buf[begin, end) into lines using the stage 1 masks. the
+// masks are computed over a bounded window that slides along with the
+// scanner, so memory use does not grow with the buffer. end must fall on a
+// line boundary.
+class line_scanner {
+public:
+    static constexpr std::size_t WINDOW = 1 << 16;
+
+    explicit constexpr line_scanner(std::string_view buf,
+                          std::size_t begin = 0,
+                          std::size_t end = bits::npos,
+                          bool force_scalar = false)
+        : buf_(buf),
+          pos_(begin),
+          end_(std::min(end, buf.size())),
+          force_scalar_(force_scalar)
+    {
+
+    }
+
+    NO_DISCARD constexpr std::string_view buffer() const noexcept { return buf_; }
+    NO_DISCARD constexpr std::size_t position() const noexcept { return pos_; }
+    // lines returned by next() so far
+    NO_DISCARD constexpr std::size_t lines() const noexcept { return line_; }
+
+    // scans the next line into t. returns false once the range is exhausted.
+    constexpr bool next(line_tokens& t) {
+        if (pos_ >= end_)
+            return false;
+
+        std::size_t window = WINDOW;
+        while (!scan_line(t)) {
+            // the line did not end inside the current window
+            window *= 2;
+            refill(window);
+        }
+        t.number = ++line_;
+        return true;
+    }
+
+    // whitespace queries over the line most recently returned by next()
+    NO_DISCARD constexpr std::size_t
+    first_whitespace(std::size_t from, std::size_t to) const noexcept {
+        return translate(bits::next_set(masks_.whitespace.data(),
+                                        from - masks_.base, to - masks_.base));
+    }
+
+    NO_DISCARD constexpr std::size_t
+    first_non_whitespace(std::size_t from, std::size_t to) const noexcept {
+        return translate(bits::next_set(masks_.whitespace.data(),
+                                        from - masks_.base, to - masks_.base,
+                                        true));
+    }
+
+    NO_DISCARD constexpr std::size_t
+    last_non_whitespace(std::size_t from, std::size_t to) const noexcept {
+        return translate(bits::prev_set(masks_.whitespace.data(),
+                                        from - masks_.base, to - masks_.base,
+                                        true));
+    }
+
+private:
+    NO_DISCARD constexpr std::size_t translate(std::size_t i) const noexcept {
+        return i == bits::npos ? i : i + masks_.base;
+    }
+
+    constexpr void refill(std::size_t window) {
+        scan_structurals(buf_, pos_, std::min(end_, pos_ + window), masks_,
+                         force_scalar_);
+    }
+
+    // tokenizes the line at pos_. returns false if its newline lies beyond
+    // the scanned window and more of the buffer remains.
+    constexpr bool scan_line(line_tokens& t) {
+        if (pos_ < masks_.base || pos_ >= masks_.base + masks_.size)
+            refill(WINDOW);
+
+        const std::uint64_t* st = masks_.structural.data();
+        const std::size_t window_end = masks_.base + masks_.size;
+
+        t.eq = t.quote_open = t.quote_close = bits::npos;
+        std::size_t content_end = bits::npos;
+        std::size_t line_end = bits::npos;
+        bool in_quote = false;
+
+        std::size_t i = pos_ - masks_.base;
+        while ((i = bits::next_set(st, i, masks_.size)) != bits::npos) {
+            const std::size_t at = masks_.base + i++;
+            switch (buf_[at]) {
+            case '\n':
+                line_end = at;
+                break;
+            case '"':
+                if (content_end != bits::npos)
+                    continue;
+                if (in_quote) {
+                    if (buf_[at - 1] != '\\') {
+                        in_quote = false;
+                        t.quote_close = at;
+                    }
+                    continue;
+                }
+                // only a quote that begins a value opens a string; one 
+                // inside a bare word, a key or a header is just a character
+                if (t.eq == bits::npos || t.quote_open != bits::npos ||
+                    first_non_whitespace(t.eq + 1, at) != bits::npos)
+                    continue;
+                in_quote = true;
+                t.quote_open = at;
+                continue;
+            case '#':
+            case ';':
+                if (!in_quote && content_end == bits::npos)
+                    content_end = at;
+                continue;
+            case '=':
+                if (!in_quote && content_end == bits::npos &&
+                    t.eq == bits::npos)
+                    t.eq = at;
+                continue;
+            default:
+                continue;
+            }
+            break;
+        }
+
+        if (line_end == bits::npos) {
+            if (window_end < end_)
+                return false;
+            line_end = window_end;
+        }
+        if (content_end == bits::npos || content_end > line_end)
+            content_end = line_end;
+
+        t.line_begin = pos_;
+        const std::size_t first = first_non_whitespace(pos_, content_end);
+        if (first == bits::npos) {
+            t.begin = t.end = content_end;
+        } else {
+            t.begin = first;
+            t.end = last_non_whitespace(first, content_end) + 1;
+        }
+
+        pos_ = line_end + 1;
+        return true;
+    }
+
+    std::string_view buf_;
+    std::size_t pos_;
+    std::size_t end_;
+    std::size_t line_ = 0;
+    bool force_scalar_;
+    structural_masks masks_;
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <memory_resource>
+#include <mutex>
+#include <shared_mutex>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "util.hpp"
+#include "hash_index.hpp"
+
+// a key name as a dense 32-bit id
+using symbol_id = std::uint32_t;
+inline static constexpr symbol_id NO_SYMBOL = 0xffffffffU;
+static_assert(NO_SYMBOL == hash_index::EMPTY);
+
+// interns key names, giving each distinct name the next id. a table only
+// grows, so a name keeps its id for as long as the table lives; documents
+// parsed with the same table, such as successive versions from a reloader,
+// agree on every id. the table is safe to use from several threads: 
+// lookups share a lock that is only held exclusively while a new name is 
+// added. documents resolve names through indexes of their own, so only
+// parsing, which interns, takes the lock.
+class symbol_table {
+public:
+    using self_type = symbol_table;
+
+    symbol_table() = default;
+    symbol_table(const self_type&) = delete;
+    self_type& operator=(const self_type&) = delete;
+
+    // returns the id of name, adding it if it is new
+    NO_DISCARD symbol_id intern(std::string_view name) {
+        const std::uint64_t h = util::hash_bytes(name);
+        {
+            const std::shared_lock lock(mutex_);
+            if (const symbol_id s = find(name, h); s != NO_SYMBOL)
+                return s;
+        }
+
+        const std::unique_lock lock(mutex_);
+        return add(name, h);
+    }
+
+    // interns each of names, whose hashes by util::hash_bytes() are given,
+    // under a single lock, storing their ids in ids. names already hashed
+    // are not hashed again.
+    void intern(std::span<const std::string_view> names,
+                std::span<const std::uint64_t> hashes,
+                std::span<symbol_id> ids) {
+        const std::unique_lock lock(mutex_);
+        names_.reserve(names_.size() + names.size());
+        hashes_.reserve(hashes_.size() + names.size());
+        for (std::size_t i = 0; i < names.size(); ++i)
+            ids[i] = add(names[i], hashes[i]);
+    }
+
+    // returns the id of name, or NO_SYMBOL if it has never been interned
+    NO_DISCARD symbol_id find(std::string_view name) const {
+        const std::uint64_t h = util::hash_bytes(name);
+        const std::shared_lock lock(mutex_);
+        return find(name, h);
+    }
+
+    // the name of s, which stays valid for as long as the table does, or
+    // an empty view if s is not an id of this table
+    NO_DISCARD std::string_view name(symbol_id s) const {
+        const std::shared_lock lock(mutex_);
+        return s < names_.size() ? names_[s] : std::string_view{};
+    }
+
+    NO_DISCARD std::size_t size() const {
+        const std::shared_lock lock(mutex_);
+        return names_.size();
+    }
+
+private:
+    NO_DISCARD symbol_id 
+    find(std::string_view name, std::uint64_t h) const noexcept {
+        return index_.find(h, [&](auto i) { return names_[i] == name; });
+    }
+
+    // the id of name, added if it is new; the lock must be held exclusively
+    symbol_id add(std::string_view name, std::uint64_t h) {
+        if (const symbol_id s = find(name, h); s != NO_SYMBOL)
+            return s;
+        if (names_.size() >= NO_SYMBOL)
+            throw std::length_error("too many symbols.");
+
+        auto* chars = static_cast<char*>(arena_.allocate(name.size(), 1));
+        std::copy(name.begin(), name.end(), chars);
+        const auto s = static_cast<symbol_id>(names_.size());
+        names_.emplace_back(chars, name.size());
+        hashes_.push_back(h);
+
+        // grows by doubling, reinserting from the saved hashes
+        if (names_.size() * 2 > index_.capacity()) {
+            index_.reset(names_.size() * 2);
+            for (symbol_id i = 0; i < names_.size(); ++i)
+                index_.insert(hashes_[i], i, [](auto) { return false; });
+        } else {
+            index_.insert(h, s, [](auto) { return false; });
+        }
+        return s;
+    }
+
+    mutable std::shared_mutex mutex_;
+    std::pmr::monotonic_buffer_resource arena_;  // the names' characters
+    std::vector<std::string_view> names_;
+    std::vector<std::uint64_t> hashes_;
+    hash_index index_;
+};
@@ -0,0 +1,374 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+#include <algorithm>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#if defined __unix__ || defined __APPLE__
+#   define HAS_UNISTD 1
+#   include <cerrno>
+#   include <unistd.h>
+#endif
+
+#include "util.hpp"
+#include "confparse.hpp"
+
+struct write_options {
+    // copy comments, blank lines, headers and the lines of unchanged kvs
+    // byte for byte from the document's text. changed kvs are rewritten
+    // where they were, removed ones are dropped and new ones are appended
+    // to their section. the document must have been parsed from its text,
+    // not loaded from a cache.
+    bool keep_original = false;
+};
+
+namespace writer {
+
+// a string can be written without quotes if it reads back as the same
+// string, in an array or not: no whitespace, comment characters or array
+// punctuation, no leading quote, and nothing that classifies as a number
+// or bool
+NO_DISCARD constexpr bool STRING_WRITES_BARE(std::string_view s) noexcept {
+    if (s.empty() || s.front() == '"' || s.front() == '[')
+        return false;
+    for (const char c : s) {
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n' ||
+            c == '#' || c == ';' || c == ',' || c == ']')
+            return false;
+    }
+    const value_class c = classify_value(s);
+    return c.type == KV_PAIR_VALUE::STRING && c.digits.size() == s.size();
+}
+
+// quotes are not unescaped when read, so a quoted string can hold escaped
+// quotes but no bare ones, and cannot end in the escape that would hide
+// its closing quote
+NO_DISCARD constexpr bool STRING_WRITES_QUOTED(std::string_view s) noexcept {
+    if (!s.empty() && s.back() == '\\')
+        return false;
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '\n' || (s[i] == '"' && (i == 0 || s[i - 1] != '\\')))
+            return false;
+    }
+    return true;
+}
+
+// formats into a memory buffer, handing it to an fd whenever it fills up
+class text_writer {
+public:
+    static constexpr std::size_t FLUSH_AT = 1 << 16;
+
+    explicit text_writer(fmt::memory_buffer& out, int fd = -1)
+        : out_(out),
+          fd_(fd)
+    {
+
+    }
+
+    void raw(std::string_view s) {
+        out_.append(s);
+        maybe_flush();
+    }
+
+    void header(std::string_view path) {
+        fmt::format_to(std::back_inserter(out_), "[{}]\n", path);
+        maybe_flush();
+    }
+
+    // one "key = value" line
+    void kv(std::string_view key, const kv::value_ref& v) {
+        out_.append(key);
+        out_.append(std::string_view(" = "));
+        value(v);
+        out_.push_back('\n');
+        maybe_flush();
+    }
+
+    // throws std::invalid_argument for values that cannot be read back:
+    // errors, non-finite floats and unrepresentable strings
+    void value(const kv::value_ref& v) {
+        auto it = std::back_inserter(out_);
+        switch (v.type()) {
+        case KV_PAIR_VALUE::BOOL:
+            out_.append(std::string_view(*v.v->as_bool(v.st) ? "true" : "false"));
+            return;
+        case KV_PAIR_VALUE::INT: {
+            // the parser only makes an INT of a negative number, "-0"
+            // included
+            const std::intmax_t i = *v.v->as_int(v.st);
+            if (i == 0)
+                out_.append(std::string_view("-0"));
+            else
+                fmt::format_to(it, "{}", i);
+            return;
+        }
+        case KV_PAIR_VALUE::UINT:
+            fmt::format_to(it, "{}", *v.v->as_uint(v.st));
+            return;
+        case KV_PAIR_VALUE::FLOAT:
+            floating(*v.v->as_float(v.st));
+            return;
+        case KV_PAIR_VALUE::STRING: {
+            const auto s = v.as<std::string_view>();
+            if (!s)
+                throw std::invalid_argument("string outside its storage.");
+            string(*s);
+            return;
+        }
+        case KV_PAIR_VALUE::ARRAY: {
+            const auto n = v.v->array_size(v.st);
+            if (!n)
+                throw std::invalid_argument("array outside its storage.");
+            out_.push_back('[');
+            for (std::size_t i = 0; i < *n; ++i) {
+                if (i != 0)
+                    out_.append(std::string_view(", "));
+                const kv::value e = v.v->element(v.st, i);
+                value({ &e, v.st });
+            }
+            out_.push_back(']');
+            return;
+        }
+        case KV_PAIR_VALUE::ERR:
+            break;
+        }
+        throw std::invalid_argument("cannot write an invalid value.");
+    }
+
+    // writes out whatever is buffered if writing to an fd
+    void flush() {
+        if (fd_ < 0)
+            return;
+#ifdef HAS_UNISTD
+        const char* p = out_.data();
+        std::size_t left = out_.size();
+        while (left != 0) {
+            const ssize_t n = ::write(fd_, p, left);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("error writing document.");
+            }
+            p += n;
+            left -= static_cast<std::size_t>(n);
+        }
+#endif
+        out_.clear();
+    }
+
+private:
+    void maybe_flush() {
+        if (fd_ >= 0 && out_.size() >= FLUSH_AT)
+            flush();
+    }
+
+    // the shortest form that reads back as the same number, with a
+    // fraction added to integral ones so that they stay floats
+    void floating(kv::float_type x) {
+        if (!std::isfinite(x))
+            throw std::invalid_argument("cannot write a non-finite float.");
+        const std::size_t from = out_.size();
+        fmt::format_to(std::back_inserter(out_), "{}", x);
+        const std::string_view s(out_.data() + from, out_.size() - from);
+        if (s.find_first_of(".e") == std::string_view::npos)
+            out_.append(std::string_view(".0"));
+    }
+
+    void string(std::string_view s) {
+        if (STRING_WRITES_BARE(s)) {
+            out_.append(s);
+        } else if (STRING_WRITES_QUOTED(s)) {
+            out_.push_back('"');
+            out_.append(s);
+            out_.push_back('"');
+        } else {
+            throw std::invalid_argument("string cannot be written.");
+        }
+    }
+
+    fmt::memory_buffer& out_;
+    int fd_;
+};
+
+// every section that has kvs, or is a leaf, gets a header
+inline void write_canonical(const document& doc, text_writer& w) {
+    const kv::storage st = doc.storage();
+    bool blank = doc.global().kv_count != 0;
+    for (section_id id = 0; id < doc.sections.size(); ++id) {
+        const section& s = doc.sections[id];
+        if (id != 0) {
+            if (s.kv_count == 0 && s.first_child != NO_INDEX)
+                continue;
+            if (blank)
+                w.raw("\n");
+            w.header(s.path);
+            blank = true;
+        }
+        for (const auto& p : doc.kvs_of(id))
+            w.kv(p.key, { &p.val, st });
+    }
+}
+
+inline void write_kept(const document& doc, text_writer& w) {
+    const std::string_view text = doc.text;
+    const kv::storage st = doc.storage();
+    auto in_text = [&](std::string_view s) {
+        return s.data() >= text.data() && s.data() < text.data() + text.size();
+    };
+
+    // the kvs still in the text, in the order their lines appear
+    std::vector<std::uint32_t> order;
+    for (std::uint32_t i = 0; i < doc.kvs.size(); ++i) {
+        if (in_text(doc.kvs[i].key))
+            order.push_back(i);
+    }
+    if (order.empty() && !doc.kvs.empty() && !text.empty())
+        throw std::invalid_argument("document was not parsed from its text.");
+
+    auto before = [&](std::uint32_t a, std::uint32_t b) {
+        return doc.kvs[a].key.data() < doc.kvs[b].key.data();
+    };
+    if (!std::is_sorted(order.begin(), order.end(), before))
+        std::sort(order.begin(), order.end(), before);
+
+    std::vector<bool> written(doc.kvs.size(), false);
+    auto write_new = [&](section_id id) {
+        for (const auto& p : doc.kvs_of(id)) {
+            if (!written[&p - doc.kvs.data()]) {
+                w.kv(p.key, { &p.val, st });
+                written[&p - doc.kvs.data()] = true;
+            }
+        }
+    };
+
+    line_scanner sc(text);
+    kv::array_pool arrays;
+    std::size_t next = 0;
+    bool globals = false;
+    section_id last = 0;  // the section the text ends in
+    for (line_tokens t; sc.next(t); ) {
+        const std::size_t nl = text.find('\n', t.end);
+        const std::string_view line = nl == std::string_view::npos ?
+            text.substr(t.line_begin) :
+            text.substr(t.line_begin, nl + 1 - t.line_begin);
+        auto copy = [&] {
+            w.raw(line);
+            if (line.back() != '\n')
+                w.raw("\n");
+        };
+
+        if (t.begin == t.end) {
+            copy();
+            continue;
+        }
+        if (text[t.begin] == '[') {
+            // new global kvs go before the first header
+            if (!globals) {
+                write_new(0);
+                globals = true;
+            }
+            std::string_view path;
+            if (!ERROR(parse_section_header(
+                    text.substr(t.begin, t.end - t.begin), path)))
+                last = doc.find_section(path);
+            copy();
+            continue;
+        }
+
+        // kvs whose keys no longer start a line are written as new ones
+        const char* key = text.data() + t.begin;
+        while (next != order.size() && doc.kvs[order[next]].key.data() < key)
+            ++next;
+
+        kv::pair q;
+        arrays.clear();
+        const PARSE_ERROR e = parse_kv(sc, t, q, arrays);
+        if (next == order.size() ||
+            doc.kvs[order[next]].key.data() != key) {
+            // an invalid line is kept; a valid one is a removed kv
+            if (ERROR(e))
+                copy();
+            continue;
+        }
+
+        const kv::pair& p = doc.kvs[order[next++]];
+        written[&p - doc.kvs.data()] = true;
+        const kv::value_ref v{ &p.val, st };
+        const bool same = ERROR(e) ?
+            v.type() == KV_PAIR_VALUE::ERR :
+            kv::values_equal(v, { &q.val, arrays.storage_of(text) });
+        if (same) {
+            copy();
+            continue;
+        }
+
+        // only the value is replaced; indentation and comment stay
+        w.raw(text.substr(t.line_begin, t.begin - t.line_begin));
+        w.raw(p.key);
+        w.raw(" = ");
+        w.value(v);
+        const std::string_view rest = line.substr(t.end - t.line_begin);
+        w.raw(rest);
+        if (rest.empty() || rest.back() != '\n')
+            w.raw("\n");
+    }
+    if (last != NO_INDEX)
+        write_new(last);
+    write_new(0);
+
+    // sections gaining kvs are reopened at the end; new empty ones are
+    // added as in the canonical form
+    for (section_id id = 1; id < doc.sections.size(); ++id) {
+        const section& s = doc.sections[id];
+        const auto ps = doc.kvs_of(id);
+        const bool fresh = std::any_of(ps.begin(), ps.end(), [&](const auto& p) {
+            return !written[&p - doc.kvs.data()];
+        });
+        const bool new_leaf = ps.empty() && s.first_child == NO_INDEX &&
+                              !in_text(s.path);
+        if (!fresh && !new_leaf)
+            continue;
+        w.raw("\n");
+        w.header(s.path);
+        write_new(id);
+    }
+}
+
+} // namespace writer
+
+// appends doc as config text to out. the canonical form lists the global
+// kvs and then each section's, one "key = value" per line; parsing it
+// gives back an equal document. throws std::invalid_argument if a value
+// cannot be written.
+inline void write_document(const document& doc,
+                           fmt::memory_buffer& out,
+                           const write_options& o = {}) {
+    writer::text_writer w(out);
+    if (o.keep_original)
+        writer::write_kept(doc, w);
+    else
+        writer::write_canonical(doc, w);
+}
+
+#ifdef HAS_UNISTD
+// as above, writing to fd in blocks of about text_writer::FLUSH_AT bytes.
+// throws std::runtime_error if a write fails.
+inline void write_document(const document& doc,
+                           int fd,
+                           const write_options& o = {}) {
+    fmt::memory_buffer buf;
+    writer::text_writer w(buf, fd);
+    if (o.keep_original)
+        writer::write_kept(doc, w);
+    else
+        writer::write_canonical(doc, w);
+    w.flush();
+}
+#endif